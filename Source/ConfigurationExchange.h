@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+
+namespace zl
+{
+    /*  Hands immutable configurations from a background thread to the audio
+        thread without locks, and gets the old ones deleted somewhere else.
+
+        publish()            any non-audio thread. Only the newest configuration
+                             is kept; one the audio thread never picked up is
+                             deleted straight away.
+        takePending()/
+        install()/retire()   audio thread only. One atomic exchange picks up
+                             the pending configuration; replaced or rejected
+                             ones go into a lock-free queue instead of being
+                             deleted.
+        collectGarbage()     any non-audio thread; deletes the queued ones.
+        reset()              while the audio thread is stopped (prepareToPlay).
+    */
+    template <typename Configuration>
+    class ConfigurationExchange
+    {
+    public:
+        ConfigurationExchange() = default;
+
+        ~ConfigurationExchange()
+        {
+            delete pending.exchange(nullptr);
+            collectGarbage();
+            delete current;
+        }
+
+        void publish(std::unique_ptr<Configuration> configuration) noexcept
+        {
+            delete pending.exchange(configuration.release());
+        }
+
+        void reset(std::unique_ptr<Configuration> configuration)
+        {
+            delete pending.exchange(nullptr);
+            collectGarbage();
+            delete current;
+            current = configuration.release();
+        }
+
+        void collectGarbage()
+        {
+            const juce::ScopedLock sl(collectorLock);
+
+            retired.read(retired.getNumReady()).forEach([this](int index)
+            {
+                delete retiredSlots[(size_t)index];
+                retiredSlots[(size_t)index] = nullptr;
+            });
+        }
+
+        //==============================================================================
+        const Configuration* getCurrent() const noexcept { return current; }
+
+        // the pending configuration, or nullptr; the caller must install() or retire() it
+        Configuration* takePending() noexcept { return pending.exchange(nullptr); }
+
+        void install(Configuration* configuration) noexcept
+        {
+            retire(current);
+            current = configuration;
+        }
+
+        void retire(Configuration* configuration) noexcept
+        {
+            if (configuration == nullptr)
+                return;
+
+            if (retired.getFreeSpace() == 0)
+            {
+                // the collector has stalled for a long time; freeing here beats leaking
+                jassertfalse;
+                delete configuration;
+                return;
+            }
+
+            retired.write(1).forEach([this, configuration](int index)
+            {
+                retiredSlots[(size_t)index] = configuration;
+            });
+        }
+
+    private:
+        static constexpr int queueSize = 32;
+
+        std::atomic<Configuration*> pending { nullptr };
+        Configuration* current = nullptr;
+
+        juce::AbstractFifo retired { queueSize };
+        std::array<Configuration*, (size_t)queueSize> retiredSlots {};
+        juce::CriticalSection collectorLock;   // collectors only, never the audio thread
+
+        JUCE_DECLARE_NON_COPYABLE(ConfigurationExchange)
+    };
+
+    /*  One low-priority thread shared by every instance in the process, for
+        work that must stay off the audio and message threads. Hold it with a
+        juce::SharedResourcePointer and register a juce::TimeSliceClient.
+    */
+    class BackgroundThread : public juce::TimeSliceThread
+    {
+    public:
+        BackgroundThread() : juce::TimeSliceThread("ZLDistort Background")
+        {
+            startThread(juce::Thread::Priority::low);
+        }
+
+        ~BackgroundThread() override { stopThread(2000); }
+    };
+}
@@ -0,0 +1,437 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "BlockRamp.h"
+#include "StagePipeline.h"
+
+namespace zl
+{
+    /*  Closed-form first and second antiderivatives of the shaper transfer
+        functions, evaluated on SIMDRegister<double>.
+
+        Shapes with `preGain` are g(amount * x) (the antiderivatives are taken
+        with respect to the pre-gained signal); the others are amount * g(x).
+    */
+    namespace adaa
+    {
+        using Vec = juce::dsp::SIMDRegister<double>;
+
+        inline Vec select(Vec::vMaskType mask, Vec ifTrue, Vec ifFalse) noexcept
+        {
+            return ifFalse + ((ifTrue - ifFalse) & mask);
+        }
+
+        inline Vec signOf(Vec u) noexcept
+        {
+            return Vec(1.0) - (Vec(2.0) & Vec::lessThan(u, Vec(0.0)));
+        }
+
+        inline Vec expOfMinus(Vec t) noexcept
+        {
+            Vec e;
+            for (size_t i = 0; i < Vec::SIMDNumElements; ++i)
+                e.set(i, std::exp(-t.get(i)));
+            return e;
+        }
+
+        struct HardClip
+        {
+            static constexpr bool preGain = true;
+            static constexpr double c = 0.5;
+
+            static Vec g(Vec u) noexcept { return Vec::min(Vec::max(u, Vec(-c)), Vec(c)); }
+
+            static Vec G1(Vec u) noexcept
+            {
+                const auto a = Vec::abs(u);
+                return select(Vec::lessThanOrEqual(a, Vec(c)), u * u * 0.5, a * c - c * c * 0.5);
+            }
+
+            static Vec G2(Vec u) noexcept
+            {
+                const auto a = Vec::abs(u);
+                const auto outer = signOf(u) * (u * u * (c * 0.5) - a * (c * c * 0.5) + c * c * c / 6.0);
+                return select(Vec::lessThanOrEqual(a, Vec(c)), u * u * u * (1.0 / 6.0), outer);
+            }
+        };
+
+        struct Exponential
+        {
+            static constexpr bool preGain = true;
+
+            static Vec g(Vec u) noexcept
+            {
+                return signOf(u) * (Vec(1.0) - expOfMinus(Vec::abs(u)));
+            }
+
+            static Vec G1(Vec u) noexcept
+            {
+                const auto a = Vec::abs(u);
+                return a + expOfMinus(a) - 1.0;
+            }
+
+            static Vec G2(Vec u) noexcept
+            {
+                const auto a = Vec::abs(u);
+                return signOf(u) * (u * u * 0.5 - a + Vec(1.0) - expOfMinus(a));
+            }
+        };
+
+        struct Wavefold
+        {
+            static constexpr bool preGain = false;
+
+            static Vec g(Vec u) noexcept
+            {
+                const auto twoU = u + u;
+                return u + ((Vec(1.5) - twoU) & Vec::greaterThan(u, Vec(0.5)))
+                         - ((Vec(1.5) + twoU) & Vec::lessThan(u, Vec(-0.5)));
+            }
+
+            static Vec G1(Vec u) noexcept
+            {
+                const auto a = Vec::abs(u);
+                return select(Vec::lessThanOrEqual(a, Vec(0.5)), u * u * 0.5,
+                              a * 1.5 - u * u * 0.5 - 0.5);
+            }
+
+            static Vec G2(Vec u) noexcept
+            {
+                const auto a = Vec::abs(u);
+                const auto outer = signOf(u) * (u * u * 0.75 - a * a * a * (1.0 / 6.0) - a * 0.5 + 5.0 / 48.0);
+                return select(Vec::lessThanOrEqual(a, Vec(0.5)), u * u * u * (1.0 / 6.0), outer);
+            }
+        };
+
+        /*  The foldback curve is asymmetric: above +0.5 it is a triangle wave in
+            [0, 0.5], below -0.5 a rising sawtooth in [0.5, 1.5). Both pieces are
+            integrated period by period from y = u - 0.5.
+        */
+        struct Foldback
+        {
+            static constexpr bool preGain = false;
+
+            static Vec g(Vec u) noexcept
+            {
+                const auto y = u - 0.5;
+                const auto folded = Vec::abs(y - Vec::truncate(y) - 0.5);
+                return select(Vec::greaterThan(Vec::abs(u), Vec(0.5)), folded, u);
+            }
+
+            static Vec G1(Vec u) noexcept
+            {
+                const auto y = u - 0.5;
+
+                // u > 0.5: n = floor(y), t = frac(y)
+                const auto n = Vec::truncate(y);
+                const auto t = y - n;
+                const auto lowT = Vec::lessThanOrEqual(t, Vec(0.5));
+                const auto th = t - 0.5;
+                const auto T = select(lowT, t * 0.5 - t * t * 0.5, Vec(0.125) + th * th * 0.5);
+                const auto upper = Vec(0.125) + n * 0.25 + T;
+
+                // u < -0.5: k = ceil(y), w = k - y, m = -1 - k full periods
+                const auto w = n - y;
+                const auto m = Vec(-1.0) - n;
+                const auto lower = Vec(0.125) - (w * 0.5 + w * w * 0.5 + m);
+
+                const auto middle = u * u * 0.5;
+                return select(Vec::greaterThan(u, Vec(0.5)), upper,
+                              select(Vec::lessThan(u, Vec(-0.5)), lower, middle));
+            }
+
+            static Vec G2(Vec u) noexcept
+            {
+                const auto y = u - 0.5;
+
+                const auto n = Vec::truncate(y);
+                const auto t = y - n;
+                const auto lowT = Vec::lessThanOrEqual(t, Vec(0.5));
+                const auto th = t - 0.5;
+                const auto TT = select(lowT, t * t * 0.25 - t * t * t * (1.0 / 6.0),
+                                       Vec(1.0 / 24.0) + th * 0.125 + th * th * th * (1.0 / 6.0));
+                const auto upper = Vec(1.0 / 48.0) + y * 0.125
+                                 + (n * (n - 1.0) * 0.5 + n * t) * 0.25 + n * 0.125 + TT;
+
+                const auto w = n - y;
+                const auto m = Vec(-1.0) - n;
+                const auto lower = Vec(-1.0 / 48.0) + (y + 1.0) * 0.125
+                                 + m * (5.0 / 12.0) + m * (m - 1.0) * 0.5
+                                 + w * w * 0.25 + w * w * w * (1.0 / 6.0) + m * w;
+
+                const auto middle = u * u * u * (1.0 / 6.0);
+                return select(Vec::greaterThan(u, Vec(0.5)), upper,
+                              select(Vec::lessThan(u, Vec(-0.5)), lower, middle));
+            }
+        };
+    }
+
+    //==============================================================================
+    /*  First- and second-order antiderivative anti-aliasing (ADAA) for the
+        HardClip, Exponential, Foldback and Wavefold shapers.
+
+        The antiderivatives are evaluated a register at a time; the divided
+        differences run as plain loops over contiguous double arrays. Whenever
+        a difference is ill-conditioned (consecutive inputs closer than
+        `tolerance`) the sample falls back to the midpoint formulas. Internal
+        math is double precision even for float audio, because the second-order
+        differences cancel badly in float.
+
+        The differences put the wet signal half a sample late in first order
+        and a whole sample late in second. process() delays the dry signal it
+        mixes in to match: by a first-order allpass with half a sample of
+        phase delay at low frequencies, or by one sample. Only the whole
+        sample can be reported to the host, see getLatencyInSamples(). When
+        shape() runs at an oversampled rate with the mix done outside, the
+        wet signal stays that fraction of a host sample late.
+    */
+    template <typename SampleType>
+    class AntiderivativeShaper : public ShapingStage<SampleType>
+    {
+    public:
+        using Ramp = BlockRamp<SampleType>;
+
+        enum Order
+        {
+            Off = 0,
+            FirstOrder,
+            SecondOrder
+        };
+
+        enum Function
+        {
+            HardClip = 0,
+            Exponential,
+            Foldback,
+            Wavefold
+        };
+
+        static constexpr double tolerance = 1.0e-5;
+
+        // the Thiran allpass with a phase delay of half a sample at DC
+        static constexpr double halfSampleCoefficient = 1.0 / 3.0;
+
+        // whole samples of delay at the rate process() runs at
+        static constexpr int getLatencyInSamples(int order) noexcept { return order == SecondOrder ? 1 : 0; }
+
+        void prepare(int numChannels)
+        {
+            states.assign((size_t)juce::jmax(1, numChannels), ChannelState{});
+
+            for (auto* a : { &u, &g1, &g2, &d, &y })
+                a->assign((size_t)chunkSize + (size_t)Vec::SIMDNumElements, 0.0);
+        }
+
+        void reset() noexcept
+        {
+            std::fill(states.begin(), states.end(), ChannelState{});
+        }
+
+        /*  Selects what shape() runs. The history of the old transfer function
+            is meaningless for a new one, so a change starts from silence; -1
+            marks the shaper as unused until the next change.
+        */
+        void setFunction(int newFunction, int newOrder) noexcept
+        {
+            if (newFunction == currentFunction && newOrder == currentOrder)
+                return;
+
+            reset();
+            currentFunction = newFunction;
+            currentOrder = newOrder;
+        }
+
+        void shape(juce::dsp::AudioBlock<SampleType>& block, int firstChannel,
+                   Ramp amount, Ramp dryWet) noexcept override
+        {
+            for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+            {
+                auto* data = block.getChannelPointer(ch);
+                process(currentFunction, currentOrder, firstChannel + (int)ch, data, data, (int)block.getNumSamples(), amount, dryWet);
+            }
+        }
+
+        /*  Shapes `input` into `output` (which may alias) and mixes with the dry
+            signal, carrying the history for `channel` across calls.
+        */
+        void process(int function, int order, int channel,
+                     const SampleType* input, SampleType* output, int numSamples,
+                     Ramp amount, Ramp dryWet) noexcept
+        {
+            switch (function)
+            {
+            case HardClip:    processWith<adaa::HardClip>(order, channel, input, output, numSamples, amount, dryWet); break;
+            case Exponential: processWith<adaa::Exponential>(order, channel, input, output, numSamples, amount, dryWet); break;
+            case Foldback:    processWith<adaa::Foldback>(order, channel, input, output, numSamples, amount, dryWet); break;
+            case Wavefold:    processWith<adaa::Wavefold>(order, channel, input, output, numSamples, amount, dryWet); break;
+            default:          jassertfalse; break;
+            }
+        }
+
+    private:
+        using Vec = adaa::Vec;
+        static constexpr int chunkSize = 256;
+
+        struct ChannelState
+        {
+            double u1 = 0.0, u2 = 0.0;       // u[n-1], u[n-2]
+            double g1 = 0.0, g2 = 0.0;       // G1(u[n-1]), G2(u[n-1])
+            double d1 = 0.0;                 // second-order divided difference at n-1
+            double dryIn = 0.0, dryOut = 0.0;  // the dry path's x[n-1] and, in first order, its allpass y[n-1]
+        };
+
+        int currentFunction = -1, currentOrder = Off;
+
+        static double scalar(Vec (*fn)(Vec), double value) noexcept
+        {
+            return fn(Vec(value)).get(0);
+        }
+
+        // the dry signal, aligned with the wet one
+        static SampleType delayDry(ChannelState& state, int order, SampleType x) noexcept
+        {
+            const auto previous = state.dryIn;
+            state.dryIn = (double)x;
+
+            if (order == SecondOrder)
+                return (SampleType)previous;
+
+            // y[n] = a x[n] + x[n-1] - a y[n-1]
+            state.dryOut = halfSampleCoefficient * ((double)x - state.dryOut) + previous;
+            return (SampleType)state.dryOut;
+        }
+
+        template <typename Fn>
+        void processWith(int order, int channel, const SampleType* input, SampleType* output,
+                         int numSamples, Ramp amount, Ramp dryWet) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channel, (int)states.size()));
+            auto& state = states[(size_t)channel];
+
+            for (int start = 0; start < numSamples; start += chunkSize)
+            {
+                const auto n = juce::jmin(chunkSize, numSamples - start);
+                const auto chunkAmount = amount.skipped(start);
+
+                for (int i = 0; i < n; ++i)
+                    u[(size_t)i] = Fn::preGain ? (double)input[start + i] * (double)chunkAmount[i]
+                                               : (double)input[start + i];
+
+                evaluate<Fn>(order, n);
+
+                if (order == SecondOrder)
+                    secondOrder<Fn>(state, n);
+                else
+                    firstOrder<Fn>(state, n);
+
+                for (int i = 0; i < n; ++i)
+                {
+                    const auto dry = delayDry(state, order, input[start + i]);
+                    const auto wetValue = Fn::preGain ? (SampleType)y[(size_t)i]
+                                                      : (SampleType)(y[(size_t)i] * (double)chunkAmount[i]);
+                    output[start + i] = dry + (wetValue - dry) * dryWet[start + i];
+                }
+            }
+        }
+
+        template <typename Fn>
+        void evaluate(int order, int n) noexcept
+        {
+            constexpr auto width = (int)Vec::SIMDNumElements;
+
+            // the arrays are padded to a whole register
+            for (int i = 0; i < n; i += width)
+            {
+                Vec v;
+                std::memcpy(&v.value, u.data() + i, sizeof(v.value));
+
+                if (order == SecondOrder)
+                {
+                    const auto b = Fn::G2(v);
+                    std::memcpy(g2.data() + i, &b.value, sizeof(b.value));
+                }
+                else
+                {
+                    const auto a = Fn::G1(v);
+                    std::memcpy(g1.data() + i, &a.value, sizeof(a.value));
+                }
+            }
+        }
+
+        template <typename Fn>
+        void firstOrder(ChannelState& state, int n) noexcept
+        {
+            auto prevU = state.u1, prevG = state.g1;
+
+            for (int i = 0; i < n; ++i)
+            {
+                const auto du = u[(size_t)i] - prevU;
+                y[(size_t)i] = std::abs(du) > tolerance ? (g1[(size_t)i] - prevG) / du : 0.0;
+                prevU = u[(size_t)i];
+                prevG = g1[(size_t)i];
+            }
+
+            // ill-conditioned samples: f evaluated at the midpoint
+            prevU = state.u1;
+            for (int i = 0; i < n; ++i)
+            {
+                if (std::abs(u[(size_t)i] - prevU) <= tolerance)
+                    y[(size_t)i] = scalar(Fn::g, 0.5 * (u[(size_t)i] + prevU));
+
+                prevU = u[(size_t)i];
+            }
+
+            state.u1 = u[(size_t)n - 1];
+            state.g1 = g1[(size_t)n - 1];
+        }
+
+        template <typename Fn>
+        void secondOrder(ChannelState& state, int n) noexcept
+        {
+            // d[i] = (G2(u[i]) - G2(u[i-1])) / (u[i] - u[i-1]), falling back to G1 at the midpoint
+            auto prevU = state.u1, prevG = state.g2;
+            for (int i = 0; i < n; ++i)
+            {
+                const auto du = u[(size_t)i] - prevU;
+                d[(size_t)i] = std::abs(du) > tolerance ? (g2[(size_t)i] - prevG) / du
+                                                        : scalar(Fn::G1, 0.5 * (u[(size_t)i] + prevU));
+                prevU = u[(size_t)i];
+                prevG = g2[(size_t)i];
+            }
+
+            auto u1 = state.u1, u2 = state.u2, prevD = state.d1;
+            for (int i = 0; i < n; ++i)
+            {
+                const auto u0 = u[(size_t)i];
+                const auto span = u0 - u2;
+
+                if (std::abs(span) > tolerance)
+                {
+                    y[(size_t)i] = 2.0 * (d[(size_t)i] - prevD) / span;
+                }
+                else
+                {
+                    // u[n] ~ u[n-2]: expand around their mean instead
+                    const auto mean = 0.5 * (u0 + u2);
+                    const auto delta = mean - u1;
+
+                    y[(size_t)i] = std::abs(delta) > tolerance
+                        ? 2.0 / delta * (scalar(Fn::G1, mean) + (scalar(Fn::G2, u1) - scalar(Fn::G2, mean)) / delta)
+                        : scalar(Fn::g, 0.5 * (mean + u1));
+                }
+
+                prevD = d[(size_t)i];
+                u2 = u1;
+                u1 = u0;
+            }
+
+            state.u1 = u1;
+            state.u2 = u2;
+            state.g2 = g2[(size_t)n - 1];
+            state.d1 = prevD;
+        }
+
+        std::vector<ChannelState> states;
+        std::vector<double> u, g1, g2, d, y;
+    };
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+
+namespace zl
+{
+    /*  A parameter value that moves linearly across a block:
+        sample i sees start + i * increment.
+    */
+    template <typename SampleType>
+    struct BlockRamp
+    {
+        SampleType start = 0, increment = 0;
+
+        static BlockRamp constant(SampleType value) noexcept { return { value, SampleType(0) }; }
+
+        SampleType operator[](int index) const noexcept { return start + increment * (SampleType)index; }
+
+        /* The same ramp seen from `numSamples` further into the block. */
+        BlockRamp skipped(int numSamples) const noexcept { return { (*this)[numSamples], increment }; }
+    };
+
+    /*  Block-rate replacement for SmoothedValue: once per block it hands out a
+        ramp from the previous block's target to the new one, so the hot loops
+        only ever add an increment.
+    */
+    template <typename SampleType>
+    class BlockSmoother
+    {
+    public:
+        void reset(SampleType value) noexcept { current = value; }
+
+        BlockRamp<SampleType> getNextRamp(SampleType target, int numSamples) noexcept
+        {
+            const auto increment = numSamples > 0 ? (target - current) / (SampleType)numSamples
+                                                  : SampleType(0);
+            const BlockRamp<SampleType> ramp{ current, increment };
+            current = target;
+            return ramp;
+        }
+
+    private:
+        SampleType current = 0;
+    };
+}
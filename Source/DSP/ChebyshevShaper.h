@@ -0,0 +1,203 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "ShaperKernels.h"
+
+namespace zl
+{
+    /*  Chebyshev mode: adds chosen harmonics directly, without any filters.
+
+        For x = cos(t) the Chebyshev polynomial T_h(x) is cos(h t), so a sum
+        of weighted T_h turns a full-scale sine into exactly those harmonics.
+        The weights favour the harmonics that land on degrees of the major or
+        natural minor scale above the input; the octaves and the fifth are
+        in both. The input is clamped to [-1, 1] before the polynomial, which
+        is evaluated per SIMD register with the Clenshaw recurrence.
+
+        output = x + amount / 10 * H(x), where H is the weighted sum minus
+        its value at zero, so silence stays silent. Even harmonics still
+        leave a level-dependent DC offset; a 5 Hz one-pole high-pass per
+        channel removes it from the wet signal, before the dry/wet mix, so
+        the dry signal passes unfiltered.
+    */
+    template <typename SampleType>
+    class ChebyshevShaper : public ShapingStage<SampleType>
+    {
+    public:
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+        using Ramp = BlockRamp<SampleType>;
+        using Kernels = ShaperKernels<SampleType>;
+
+        static constexpr int maxHarmonic = 16;
+
+        // c_0 ... c_maxHarmonic of the Chebyshev series H
+        using Coefficients = std::array<SampleType, (size_t)maxHarmonic + 1>;
+
+        /*  In-scale harmonics 2 ... min(numHarmonics + 1, maxHarmonic) get a
+            weight of 1 / h, the others none; the weights add up to 1.
+        */
+        static Coefficients makeCoefficients(bool minor, int numHarmonics) noexcept
+        {
+            static constexpr int major[] = { 0, 2, 4, 5, 7, 9, 11 };
+            static constexpr int naturalMinor[] = { 0, 2, 3, 5, 7, 8, 10 };
+            const auto& intervals = minor ? naturalMinor : major;
+
+            Coefficients c {};
+            SampleType total = 0;
+
+            for (int h = 2; h <= juce::jmin(numHarmonics + 1, maxHarmonic); ++h)
+            {
+                const auto semitones = juce::roundToInt(12.0 * std::log2((double)h)) % 12;
+
+                if (std::find(std::begin(intervals), std::end(intervals), semitones) != std::end(intervals))
+                {
+                    c[(size_t)h] = SampleType(1) / (SampleType)h;
+                    total += c[(size_t)h];
+                }
+            }
+
+            for (int h = 2; h <= maxHarmonic; ++h)
+            {
+                if (total > 0)
+                    c[(size_t)h] /= total;
+
+                // T_h(0) is 0 for odd h and (-1)^(h/2) for even h
+                if (h % 2 == 0)
+                    c[0] -= (h / 2) % 2 == 0 ? c[(size_t)h] : -c[(size_t)h];
+            }
+
+            return c;
+        }
+
+        /*  The memoryless part: shapes and mixes without the DC filter, e.g.
+            for drawing the transfer curve.
+        */
+        static void shape(const Coefficients& c, const SampleType* input, SampleType* output, int numSamples,
+                          Ramp amount, Ramp dryWet) noexcept
+        {
+            const auto amountOffsets = Kernels::laneOffsets(amount);
+            const auto wetOffsets = Kernels::laneOffsets(dryWet);
+            const Vec lower(SampleType(-1)), upper(SampleType(1)), scale(SampleType(0.1));
+
+            int i = 0;
+            for (; i + Kernels::width <= numSamples; i += Kernels::width)
+            {
+                const auto x = Kernels::load(input + i);
+                const auto clamped = Vec::min(Vec::max(x, lower), upper);
+                const auto depth = (Vec(amount[i]) + amountOffsets) * scale * (Vec(dryWet[i]) + wetOffsets);
+                Kernels::store(output + i, x + evaluate(c, clamped) * depth);
+            }
+
+            for (; i < numSamples; ++i)
+            {
+                const auto x = input[i];
+                const auto clamped = juce::jlimit(SampleType(-1), SampleType(1), x);
+                output[i] = x + evaluate(c, Vec(clamped)).get(0) * amount[i] * SampleType(0.1) * dryWet[i];
+            }
+        }
+
+        //==============================================================================
+        void prepare(double newSampleRate, int numChannels)
+        {
+            sampleRate = newSampleRate;
+            dcState.assign((size_t)juce::jmax(1, numChannels), {});
+            factor = 0;
+            setOversamplingFactor(1);
+        }
+
+        void reset() noexcept
+        {
+            std::fill(dcState.begin(), dcState.end(), DCState{});
+        }
+
+        // cheap when nothing changed, so it can be called every block
+        void setHarmonics(bool minor, int numHarmonics) noexcept
+        {
+            if (minor == currentMinor && numHarmonics == currentNumHarmonics)
+                return;
+
+            coefficients = makeCoefficients(minor, numHarmonics);
+            currentMinor = minor;
+            currentNumHarmonics = numHarmonics;
+        }
+
+        // process() runs at the oversampled rate
+        void setOversamplingFactor(int newFactor) noexcept
+        {
+            if (newFactor == factor)
+                return;
+
+            factor = newFactor;
+            dcPole = (SampleType)std::exp(-juce::MathConstants<double>::twoPi * dcCutoff / (sampleRate * factor));
+        }
+
+        void process(int channel, SampleType* data, int numSamples, Ramp amount, Ramp dryWet) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channel, (int)dcState.size()));
+            auto& state = dcState[(size_t)channel];
+            std::array<SampleType, (size_t)chunkSize> dry;
+
+            for (int start = 0; start < numSamples; start += chunkSize)
+            {
+                const auto n = juce::jmin(chunkSize, numSamples - start);
+                auto* chunk = data + start;
+                std::copy(chunk, chunk + n, dry.begin());
+
+                shape(coefficients, chunk, chunk, n, amount.skipped(start), Ramp::constant(1));
+
+                // y[n] = x[n] - x[n-1] + pole * y[n-1]
+                for (int i = 0; i < n; ++i)
+                {
+                    const auto x = chunk[i];
+                    state.output = x - state.input + dcPole * state.output;
+                    state.input = x;
+                    chunk[i] = state.output;
+                }
+
+                Kernels::mix(dry.data(), chunk, chunk, n, dryWet.skipped(start), SampleType(1));
+            }
+        }
+
+        void shape(juce::dsp::AudioBlock<SampleType>& block, int firstChannel,
+                   Ramp amount, Ramp dryWet) noexcept override
+        {
+            for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+                process(firstChannel + (int)ch, block.getChannelPointer(ch), (int)block.getNumSamples(), amount, dryWet);
+        }
+
+        static constexpr double dcCutoff = 5.0;
+
+    private:
+        // sum of c_k T_k(x) by Clenshaw: b_k = c_k + 2x b_(k+1) - b_(k+2)
+        static Vec evaluate(const Coefficients& c, Vec x) noexcept
+        {
+            const auto twoX = x + x;
+            Vec b1(SampleType(0)), b2(SampleType(0));
+
+            for (int k = maxHarmonic; k >= 1; --k)
+            {
+                const auto b0 = Vec(c[(size_t)k]) + twoX * b1 - b2;
+                b2 = b1;
+                b1 = b0;
+            }
+
+            return Vec(c[0]) + x * b1 - b2;
+        }
+
+        static constexpr int chunkSize = 64;
+
+        struct DCState
+        {
+            SampleType input = 0, output = 0;
+        };
+
+        Coefficients coefficients {};
+        bool currentMinor = false;
+        int currentNumHarmonics = -1;
+
+        double sampleRate = 44100.0;
+        int factor = 0;
+        SampleType dcPole = 0;
+        std::vector<DCState> dcState;
+    };
+}
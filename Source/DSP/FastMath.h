@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+
+namespace zl
+{
+    enum class MathPrecision
+    {
+        Exact = 0,
+        High,
+        Eco
+    };
+
+    /*  e^-t (t >= 0) for the exponential shapers, built only from multiply,
+        add and min so it runs on a whole SIMDRegister.
+
+        t is clamped, scaled down by 2^k, a polynomial with p(0) == 1 (so
+        silence stays exactly zero after shaping) approximates e^-s on the
+        reduced range, and the result is squared k times. Coefficients are
+        Chebyshev-node fits. Maximum absolute error over all t >= 0, measured
+        in float against std::exp (double: High < 7.1e-7, float rounding
+        in the squarings accounts for the rest):
+
+            High: < 1.01e-6  (degree 5, k = 4, t clamped at 16)
+            Eco:  < 3.5e-4   (degree 3, k = 3, t clamped at 8)
+
+        Exact calls std::exp per lane.
+    */
+    struct FastMath
+    {
+        template <MathPrecision precision, typename Vec>
+        static Vec expOfMinus(Vec t) noexcept
+        {
+            using T = typename Vec::ElementType;
+
+            if constexpr (precision == MathPrecision::High)
+            {
+                const auto s = Vec::min(t, Vec(T(16))) * T(1.0 / 16.0);
+                auto p = Vec::multiplyAdd(Vec(T(0.0394063729)), s, Vec(T(-0.00554793305)));
+                p = Vec::multiplyAdd(Vec(T(-0.165886567)), s, p);
+                p = Vec::multiplyAdd(Vec(T(0.499903992)), s, p);
+                p = Vec::multiplyAdd(Vec(T(-0.999998086)), s, p);
+                p = Vec::multiplyAdd(Vec(T(1)), s, p);
+                p *= p; p *= p; p *= p; p *= p;
+                return p;
+            }
+            else if constexpr (precision == MathPrecision::Eco)
+            {
+                const auto s = Vec::min(t, Vec(T(8))) * T(1.0 / 8.0);
+                auto p = Vec::multiplyAdd(Vec(T(0.482241526)), s, Vec(T(-0.11613864)));
+                p = Vec::multiplyAdd(Vec(T(-0.999024783)), s, p);
+                p = Vec::multiplyAdd(Vec(T(1)), s, p);
+                p *= p; p *= p; p *= p;
+                return p;
+            }
+            else
+            {
+                Vec e;
+                for (size_t i = 0; i < Vec::SIMDNumElements; ++i)
+                    e.set(i, std::exp(-t.get(i)));
+                return e;
+            }
+        }
+    };
+}
@@ -0,0 +1,166 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "HarmonicFilterBank.h"
+#include "HarmonicScale.h"
+#include "SpectralHarmonicBank.h"
+#include "MultirateHarmonicBank.h"
+#include "SharedTableCache.h"
+
+namespace zl
+{
+    // the parameters that decide the Harmonic-mode band layout
+    struct HarmonicBandSettings
+    {
+        int rootNote = -1, numBands = 0;
+        bool minor = false;
+        float q = 0.0f;
+
+        bool operator== (const HarmonicBandSettings& other) const noexcept
+        {
+            return rootNote == other.rootNote && numBands == other.numBands
+                && minor == other.minor && q == other.q;
+        }
+
+        bool operator!= (const HarmonicBandSettings& other) const noexcept { return ! (*this == other); }
+    };
+
+    /*  Every band coefficient for one root note, scale and Q at one sample
+        rate, for all Harmonic engines and the largest band count.
+
+        Nothing in here depends on the instance or the band count, so one
+        copy is shared by every instance through Cache.
+    */
+    struct HarmonicTables
+    {
+        static constexpr int maxBands = 20;
+
+        struct Key
+        {
+            double sampleRate = 0.0;
+            int rootNote = 0;
+            bool minor = false;
+            float q = 0.0f;
+
+            bool operator< (const Key& other) const noexcept
+            {
+                return std::tie(sampleRate, rootNote, minor, q)
+                     < std::tie(other.sampleRate, other.rootNote, other.minor, other.q);
+            }
+        };
+
+        using Cache = SharedTableCache<Key, HarmonicTables>;
+
+        std::vector<std::array<double, 5>> coefficients;   // one per band
+
+        // the same bands as bin weights for SpectralHarmonicBank
+        int spectralOrder = 0;
+        std::vector<SpectralBand> spectralBands;
+
+        // the same bands for MultirateHarmonicBank, each designed at its level's rate
+        std::vector<int> multirateLevels;
+        std::vector<std::array<double, 5>> multirateCoefficients;
+
+        static std::unique_ptr<HarmonicTables> build(const Key& key)
+        {
+            auto tables = std::make_unique<HarmonicTables>();
+            const auto numLevels = MultirateLayout::getNumLevels(key.sampleRate);
+            tables->spectralOrder = SpectralLayout::getOrder(key.sampleRate);
+
+            for (auto* v : { &tables->coefficients, &tables->multirateCoefficients })
+                v->reserve((size_t)maxBands);
+
+            tables->spectralBands.reserve((size_t)maxBands);
+            tables->multirateLevels.reserve((size_t)maxBands);
+
+            for (int band = 0; band < maxBands; ++band)
+            {
+                const auto frequency = HarmonicScale::getBandFrequency(key.rootNote, key.minor, band);
+                const auto c = HarmonicFilterBank<double>::makeBandPass(key.sampleRate, frequency, (double)key.q);
+                const auto level = juce::jmin(numLevels, MultirateLayout::getBandLevel(key.sampleRate, frequency));
+
+                tables->coefficients.push_back(c);
+                tables->spectralBands.push_back(SpectralLayout::makeBand(c, tables->spectralOrder));
+                tables->multirateLevels.push_back(level);
+                tables->multirateCoefficients.push_back(HarmonicFilterBank<double>::makeBandPass(
+                    key.sampleRate / (double)(1 << level), frequency, (double)key.q));
+            }
+
+            return tables;
+        }
+
+        size_t getSizeInBytes() const noexcept
+        {
+            auto bytes = sizeof(*this)
+                       + (coefficients.size() + multirateCoefficients.size()) * sizeof(std::array<double, 5>)
+                       + multirateLevels.size() * sizeof(int)
+                       + spectralBands.size() * sizeof(SpectralBand);
+
+            for (const auto& band : spectralBands)
+                bytes += band.weights.size() * sizeof(float);
+
+            return bytes;
+        }
+    };
+
+    /*  One band layout at one sample rate: the settings, and the shared
+        tables they select from.
+
+        Built off the audio thread and never changed afterwards, so once it
+        has been handed over (see ConfigurationExchange) the audio thread
+        only copies numbers out of it. Whoever deletes it may drop the last
+        reference to its tables, which the exchange never does on the audio
+        thread.
+    */
+    struct HarmonicConfiguration
+    {
+        double sampleRate = 0.0;
+        HarmonicBandSettings settings;
+        std::shared_ptr<const HarmonicTables> tables;
+
+        bool matches(double rate, const HarmonicBandSettings& other) const noexcept
+        {
+            return sampleRate == rate && settings == other;
+        }
+
+        static std::unique_ptr<HarmonicConfiguration> build(HarmonicTables::Cache& cache, double sampleRate,
+                                                            const HarmonicBandSettings& settings)
+        {
+            auto configuration = std::make_unique<HarmonicConfiguration>();
+            configuration->sampleRate = sampleRate;
+            configuration->settings = settings;
+
+            const HarmonicTables::Key key { sampleRate, settings.rootNote, settings.minor, settings.q };
+            configuration->tables = cache.get(key, [&key] { return HarmonicTables::build(key); });
+
+            return configuration;
+        }
+
+        int getNumBands() const noexcept { return juce::jlimit(0, HarmonicTables::maxBands, settings.numBands); }
+
+        // audio thread: loads every band; the bank's filter state is untouched
+        template <typename SampleType>
+        void applyTo(HarmonicFilterBank<SampleType>& bank) const noexcept
+        {
+            // bands are stored first so a growing band count never unmutes a stale band
+            const auto numStored = juce::jmin(bank.getMaxBands(), (int)tables->coefficients.size());
+
+            for (int band = 0; band < numStored; ++band)
+                bank.setBand(band, tables->coefficients[(size_t)band]);
+
+            bank.setNumActiveBands(getNumBands());
+        }
+
+        template <typename SampleType>
+        void applyTo(SpectralHarmonicBank<SampleType>& bank) const noexcept
+        {
+            bank.setBands(&tables->spectralBands, getNumBands(), tables->spectralOrder);
+        }
+
+        template <typename SampleType>
+        void applyTo(MultirateHarmonicBank<SampleType>& bank) const noexcept
+        {
+            bank.setBands(tables->multirateLevels, tables->multirateCoefficients, getNumBands());
+        }
+    };
+}
@@ -0,0 +1,405 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "ShaperKernels.h"
+#include "HarmonicStage.h"
+
+namespace zl
+{
+    /*  Band-pass + exponential-saturation filter bank for Harmonic mode.
+
+        Band coefficients and per-channel filter states live in contiguous
+        structure-of-arrays storage, one SIMD lane per band. For each input
+        sample every group of SIMDNumElements bands is filtered, shaped and
+        summed in the same pass, so adding bands costs one extra register
+        operation per group rather than another pass over the buffer.
+
+        Only the groups holding the first getNumActiveBands() bands are run;
+        inactive lanes inside the last group have zero coefficients and
+        contribute nothing. Retuning a band recomputes just that band's
+        coefficients and leaves every filter state untouched.
+
+        On buses with at least SIMDNumElements channels processChannels()
+        turns the layout around: one lane per channel, bands run one after
+        another with broadcast coefficients. That needs no horizontal sum
+        and wastes no lanes when the band count is not a multiple of the
+        register width.
+
+        As a pipeline stage it runs processChannels() over the block's channels.
+    */
+    template <typename SampleType>
+    class HarmonicFilterBank : public HarmonicStage<SampleType>
+    {
+    public:
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+        static constexpr int lanes = (int)Vec::SIMDNumElements;
+
+        void prepare(int numChannelsToUse, int maxBandsToUse)
+        {
+            numChannels = juce::jmax(1, numChannelsToUse);
+            maxBands = juce::jmax(1, maxBandsToUse);
+            numGroups = (maxBands + lanes - 1) / lanes;
+            numActiveBands = maxBands;
+            numActiveGroups = numGroups;
+
+            bands.assign((size_t)maxBands, Coefficients{});
+
+            for (auto* c : { &b0, &b1, &b2, &a1, &a2 })
+                c->assign((size_t)numGroups, Vec(SampleType(0)));
+
+            z1.assign((size_t)(numGroups * numChannels), Vec(SampleType(0)));
+            z2.assign((size_t)(numGroups * numChannels), Vec(SampleType(0)));
+
+            broadcast.assign((size_t)maxBands, BroadcastCoefficients{});
+            numChannelGroups = (numChannels + lanes - 1) / lanes;
+            channelZ1.assign((size_t)(numChannelGroups * maxBands), Vec(SampleType(0)));
+            channelZ2.assign((size_t)(numChannelGroups * maxBands), Vec(SampleType(0)));
+        }
+
+        /*  Sizes the per-band-group scratch that processChannelsParallel()
+            needs on narrow buses. Call after prepare(), and only while
+            rendering offline; allocates.
+        */
+        void prepareParallel(int maxBlockSize)
+        {
+            partialCapacity = juce::jmax(1, maxBlockSize);
+            const auto numPartialChannels = numChannels < lanes ? numChannels : 0;
+            partials.assign((size_t)(numPartialChannels * numGroups * partialCapacity), Vec(SampleType(0)));
+        }
+
+        // frees the scratch again when going back to real time
+        void releaseParallel()
+        {
+            partialCapacity = 0;
+            partials.clear();
+            partials.shrink_to_fit();
+        }
+
+        bool isPreparedForParallel() const noexcept { return partialCapacity > 0; }
+
+        void reset() noexcept
+        {
+            for (auto* state : { &z1, &z2, &channelZ1, &channelZ2 })
+                std::fill(state->begin(), state->end(), Vec(SampleType(0)));
+        }
+
+        int getMaxBands() const noexcept { return maxBands; }
+        int getNumActiveBands() const noexcept { return numActiveBands; }
+
+        size_t getSizeInBytes() const noexcept
+        {
+            auto bytes = bands.size() * sizeof(Coefficients) + broadcast.size() * sizeof(BroadcastCoefficients);
+
+            for (const auto* v : { &b0, &b1, &b2, &a1, &a2, &z1, &z2, &channelZ1, &channelZ2, &partials })
+                bytes += v->size() * sizeof(Vec);
+
+            return bytes;
+        }
+
+        using Coefficients = std::array<double, 5>;   // b0, b1, b2, a1, a2
+
+        /*  The same RBJ band-pass (constant 0 dB peak) that
+            juce::dsp::IIR::Coefficients::makeBandPass produces, without allocating.
+        */
+        static Coefficients makeBandPass(double sampleRate, double frequency, double q) noexcept
+        {
+            // keep the centre safely below Nyquist
+            frequency = juce::jmin(frequency, 0.49 * sampleRate);
+
+            const auto n = 1.0 / std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+            const auto nSquared = n * n;
+            const auto invQ = 1.0 / q;
+            const auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+
+            return { c1 * n * invQ, 0.0, -c1 * n * invQ,
+                     c1 * 2.0 * (1.0 - nSquared), c1 * (1.0 - invQ * n + nSquared) };
+        }
+
+        /*  Sets one band's coefficients, e.g. from makeBandPass(). Cheap
+            enough for the audio thread; filter state is left untouched.
+        */
+        void setBand(int band, const Coefficients& coefficients) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(band, maxBands));
+            bands[(size_t)band] = coefficients;
+
+            if (band < numActiveBands)
+                setLane(band, coefficients);
+        }
+
+        /*  Only the first numBands bands are filtered; the others are muted but
+            keep their coefficients for when they are switched back on.
+        */
+        void setNumActiveBands(int numBands) noexcept
+        {
+            numBands = juce::jlimit(0, maxBands, numBands);
+            if (numBands == numActiveBands)
+                return;
+
+            static constexpr Coefficients silent{};
+
+            for (int band = 0; band < maxBands; ++band)
+                setLane(band, band < numBands ? bands[(size_t)band] : silent);
+
+            numActiveBands = numBands;
+            numActiveGroups = (numBands + lanes - 1) / lanes;
+        }
+
+        /*  Selects how the per-band exponential is evaluated; see FastMath. */
+        void setPrecision(MathPrecision newPrecision) noexcept { precision = newPrecision; }
+
+        /*  Runs process() over the first `numChannelsToProcess` channels, or
+            the channel-lane path when there are enough channels to fill a
+            register. The choice depends only on the channel count, so each
+            channel keeps using the same filter state from block to block.
+        */
+        void processChannels(const SampleType* const* input, SampleType* const* output,
+                             int numChannelsToProcess, int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            jassert(numChannelsToProcess <= numChannels);
+
+            if (numChannelsToProcess < lanes)
+            {
+                for (int ch = 0; ch < numChannelsToProcess; ++ch)
+                    process(ch, input[ch], output[ch], numSamples, amount);
+
+                return;
+            }
+
+            switch (precision)
+            {
+            case MathPrecision::High: processChannelLanes<MathPrecision::High>(input, output, numChannelsToProcess, numSamples, amount); break;
+            case MathPrecision::Eco:  processChannelLanes<MathPrecision::Eco>(input, output, numChannelsToProcess, numSamples, amount); break;
+            default:                  processChannelLanes<MathPrecision::Exact>(input, output, numChannelsToProcess, numSamples, amount); break;
+            }
+        }
+
+        /*  Same result as processChannels(), bit for bit, with the work spread
+            over `scheduler` (anything with parallelFor(numTasks, task)).
+
+            Wide buses get one task per group of channel lanes. Narrow buses
+            get one task per channel and band group: each task stores its
+            group's shaped output, and the groups are then summed in the same
+            order process() sums them.
+        */
+        template <typename Scheduler>
+        void processChannelsParallel(const SampleType* const* input, SampleType* const* output,
+                                     int numChannelsToProcess, int numSamples, BlockRamp<SampleType> amount,
+                                     Scheduler& scheduler)
+        {
+            jassert(numChannelsToProcess <= numChannels);
+
+            if (numChannelsToProcess >= lanes)
+            {
+                const auto numTasks = (numChannelsToProcess + lanes - 1) / lanes;
+
+                scheduler.parallelFor(numTasks, [&](int task)
+                {
+                    const auto first = task * lanes;
+                    const auto groupSize = juce::jmin(lanes, numChannelsToProcess - first);
+
+                    dispatchPrecision([&](auto p)
+                    {
+                        processChannelGroup<decltype(p)::value>(first, groupSize, input, output, numSamples, amount);
+                    });
+                });
+
+                return;
+            }
+
+            jassert(numSamples <= partialCapacity);
+            jassert(partials.size() >= (size_t)(numChannelsToProcess * numGroups * partialCapacity));
+
+            scheduler.parallelFor(numChannelsToProcess * numActiveGroups, [&](int task)
+            {
+                const auto channel = task / numActiveGroups;
+                const auto group = task % numActiveGroups;
+
+                dispatchPrecision([&](auto p)
+                {
+                    processBandGroup<decltype(p)::value>(channel, group, input[channel],
+                                                         getPartials(channel, group), numSamples, amount);
+                });
+            });
+
+            for (int ch = 0; ch < numChannelsToProcess; ++ch)
+            {
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    Vec sum(SampleType(0));
+
+                    for (int g = 0; g < numActiveGroups; ++g)
+                        sum += getPartials(ch, g)[i];
+
+                    output[ch][i] = sum.sum();
+                }
+            }
+        }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept override
+        {
+            this->runBank(*this, block, offset);
+        }
+
+        /*  Filters `input` through every band, saturates each band with the
+            exponential shaper and writes the sum of all bands to `output`.
+        */
+        void process(int channel, const SampleType* input, SampleType* output,
+                     int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            switch (precision)
+            {
+            case MathPrecision::High: processWith<MathPrecision::High>(channel, input, output, numSamples, amount); break;
+            case MathPrecision::Eco:  processWith<MathPrecision::Eco>(channel, input, output, numSamples, amount); break;
+            default:                  processWith<MathPrecision::Exact>(channel, input, output, numSamples, amount); break;
+            }
+        }
+
+    private:
+        template <MathPrecision shaperPrecision>
+        void processWith(int channel, const SampleType* input, SampleType* output,
+                         int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channel, numChannels));
+
+            auto* s1 = z1.data() + channel * numGroups;
+            auto* s2 = z2.data() + channel * numGroups;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const Vec x(input[i]);
+                const Vec amountV(amount[i]);
+                Vec sum(SampleType(0));
+
+                for (int g = 0; g < numActiveGroups; ++g)
+                {
+                    // transposed direct form II, as juce::dsp::IIR::Filter
+                    const auto y = b0[(size_t)g] * x + s1[g];
+                    s1[g] = b1[(size_t)g] * x - a1[(size_t)g] * y + s2[g];
+                    s2[g] = b2[(size_t)g] * x - a2[(size_t)g] * y;
+
+                    sum += ExponentialShape<SampleType, shaperPrecision>::vector(y, amountV);
+                }
+
+                output[i] = sum.sum();
+            }
+        }
+
+        // one band group of one channel, as in processWith(), kept per sample
+        template <MathPrecision shaperPrecision>
+        void processBandGroup(int channel, int group, const SampleType* input, Vec* shaped,
+                              int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            auto* s1 = z1.data() + channel * numGroups + group;
+            auto* s2 = z2.data() + channel * numGroups + group;
+            const auto g = (size_t)group;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const Vec x(input[i]);
+                const Vec amountV(amount[i]);
+
+                const auto y = b0[g] * x + *s1;
+                *s1 = b1[g] * x - a1[g] * y + *s2;
+                *s2 = b2[g] * x - a2[g] * y;
+
+                shaped[i] = ExponentialShape<SampleType, shaperPrecision>::vector(y, amountV);
+            }
+        }
+
+        // one lane per channel; the last group is zero-padded
+        template <MathPrecision shaperPrecision>
+        void processChannelLanes(const SampleType* const* input, SampleType* const* output,
+                                 int numChannelsToProcess, int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            for (int first = 0; first < numChannelsToProcess; first += lanes)
+                processChannelGroup<shaperPrecision>(first, juce::jmin(lanes, numChannelsToProcess - first),
+                                                     input, output, numSamples, amount);
+        }
+
+        template <MathPrecision shaperPrecision>
+        void processChannelGroup(int first, int groupSize, const SampleType* const* input, SampleType* const* output,
+                                 int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            auto* s1 = channelZ1.data() + (first / lanes) * maxBands;
+            auto* s2 = channelZ2.data() + (first / lanes) * maxBands;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                Vec x(SampleType(0));
+
+                for (int lane = 0; lane < groupSize; ++lane)
+                    x.set((size_t)lane, input[first + lane][i]);
+
+                const Vec amountV(amount[i]);
+                Vec sum(SampleType(0));
+
+                for (int band = 0; band < numActiveBands; ++band)
+                {
+                    const auto& c = broadcast[(size_t)band];
+                    const auto y = c.b0 * x + s1[band];
+                    s1[band] = c.b1 * x - c.a1 * y + s2[band];
+                    s2[band] = c.b2 * x - c.a2 * y;
+
+                    sum += ExponentialShape<SampleType, shaperPrecision>::vector(y, amountV);
+                }
+
+                for (int lane = 0; lane < groupSize; ++lane)
+                    output[first + lane][i] = sum.get((size_t)lane);
+            }
+        }
+
+        template <typename Function>
+        void dispatchPrecision(Function&& function) const
+        {
+            switch (precision)
+            {
+            case MathPrecision::High: function(std::integral_constant<MathPrecision, MathPrecision::High>()); break;
+            case MathPrecision::Eco:  function(std::integral_constant<MathPrecision, MathPrecision::Eco>()); break;
+            default:                  function(std::integral_constant<MathPrecision, MathPrecision::Exact>()); break;
+            }
+        }
+
+        Vec* getPartials(int channel, int group) noexcept
+        {
+            return partials.data() + (size_t)((channel * numGroups + group) * partialCapacity);
+        }
+
+        void setLane(int band, const Coefficients& c) noexcept
+        {
+            const auto group = (size_t)(band / lanes);
+            const auto lane = (size_t)(band % lanes);
+
+            b0[group].set(lane, (SampleType)c[0]);
+            b1[group].set(lane, (SampleType)c[1]);
+            b2[group].set(lane, (SampleType)c[2]);
+            a1[group].set(lane, (SampleType)c[3]);
+            a2[group].set(lane, (SampleType)c[4]);
+
+            broadcast[(size_t)band] = { Vec((SampleType)c[0]), Vec((SampleType)c[1]), Vec((SampleType)c[2]),
+                                        Vec((SampleType)c[3]), Vec((SampleType)c[4]) };
+        }
+
+        struct BroadcastCoefficients
+        {
+            Vec b0, b1, b2, a1, a2;
+        };
+
+        std::vector<Coefficients> bands;
+        std::vector<Vec> b0, b1, b2, a1, a2;
+        std::vector<Vec> z1, z2;   // [channel * numGroups + group]
+
+        // channel-lane layout
+        std::vector<BroadcastCoefficients> broadcast;
+        std::vector<Vec> channelZ1, channelZ2;   // [channelGroup * maxBands + band]
+
+        // shaped output per channel and band group, for processChannelsParallel()
+        std::vector<Vec> partials;
+        int partialCapacity = 0;
+
+        int numChannels = 0, maxBands = 0, numGroups = 0, numChannelGroups = 0;
+        int numActiveBands = 0, numActiveGroups = 0;
+        MathPrecision precision = MathPrecision::Exact;
+    };
+}
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+
+namespace zl
+{
+    /*  Maps Harmonic-mode band indices onto scale degrees.
+
+        Band 0 is the root note in octave 3 (C3 = MIDI 48); each further band
+        is the next degree of the major or natural minor scale, climbing into
+        the octaves above.
+    */
+    struct HarmonicScale
+    {
+        static constexpr int baseMidiNote = 48;
+
+        static int getBandMidiNote(int rootNote, bool minor, int band) noexcept
+        {
+            static constexpr int major[] = { 0, 2, 4, 5, 7, 9, 11 };
+            static constexpr int naturalMinor[] = { 0, 2, 3, 5, 7, 8, 10 };
+
+            const auto& intervals = minor ? naturalMinor : major;
+            return baseMidiNote + rootNote + 12 * (band / 7) + intervals[band % 7];
+        }
+
+        static double getBandFrequency(int rootNote, bool minor, int band) noexcept
+        {
+            return 440.0 * std::pow(2.0, (getBandMidiNote(rootNote, minor, band) - 69) / 12.0);
+        }
+    };
+}
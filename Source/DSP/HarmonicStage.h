@@ -0,0 +1,203 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "BlockRamp.h"
+#include "ShaperKernels.h"
+#include "StagePipeline.h"
+#include "../TaskScheduler.h"
+
+namespace zl
+{
+    /*  A stage of Harmonic mode. The engines read the dry signal from the
+        block and write their summed bands to the wet scratch given to
+        setBlock(); the later stages fade, delay and mix the two.
+
+        The wet scratch has at least the block's channels and the largest
+        sub-block's length; every sub-block uses it from its start. With a
+        scheduler the engines spread their channels over its threads.
+    */
+    template <typename SampleType>
+    class HarmonicStage : public ProcessingStage<SampleType>
+    {
+    public:
+        using Ramp = BlockRamp<SampleType>;
+
+        static constexpr int maxChannels = 64;
+
+        void setBlock(juce::dsp::AudioBlock<SampleType> newWet, Ramp newAmount,
+                      TaskScheduler* newScheduler = nullptr) noexcept
+        {
+            wetScratch = newWet;
+            distortionAmount = newAmount;
+            taskScheduler = newScheduler;
+        }
+
+    protected:
+        // the part of the wet scratch that goes with `block`
+        juce::dsp::AudioBlock<SampleType> getWet(const juce::dsp::AudioBlock<SampleType>& block) const noexcept
+        {
+            jassert(block.getNumChannels() <= wetScratch.getNumChannels()
+                    && block.getNumSamples() <= wetScratch.getNumSamples());
+            return wetScratch.getSubsetChannelBlock(0, block.getNumChannels()).getSubBlock(0, block.getNumSamples());
+        }
+
+        /*  Runs `bank`'s processChannels() from the block into the wet
+            scratch, or its processChannelsParallel() given a scheduler.
+        */
+        template <typename Bank>
+        void runBank(Bank& bank, const juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept
+        {
+            const auto numChannels = (int)block.getNumChannels();
+            jassert(numChannels <= maxChannels);
+
+            auto sums = getWet(block);
+            std::array<const SampleType*, (size_t)maxChannels> inputs;
+            std::array<SampleType*, (size_t)maxChannels> outputs;
+
+            for (int ch = 0; ch < juce::jmin(numChannels, maxChannels); ++ch)
+            {
+                inputs[(size_t)ch] = block.getChannelPointer((size_t)ch);
+                outputs[(size_t)ch] = sums.getChannelPointer((size_t)ch);
+            }
+
+            const auto numSamples = (int)block.getNumSamples();
+            const auto amount = distortionAmount.skipped(offset);
+
+            // offline only; bit-identical to the single-threaded path
+            if (taskScheduler != nullptr)
+                bank.processChannelsParallel(inputs.data(), outputs.data(), numChannels, numSamples, amount, *taskScheduler);
+            else
+                bank.processChannels(inputs.data(), outputs.data(), numChannels, numSamples, amount);
+        }
+
+        juce::dsp::AudioBlock<SampleType> wetScratch;
+        Ramp distortionAmount = Ramp::constant(0);
+        TaskScheduler* taskScheduler = nullptr;
+    };
+
+    /*  Fades a new band layout in over the previous one, which keeps running
+        on its own scratch until the fade is done. Goes right after the
+        engine running the new layout.
+    */
+    template <typename SampleType>
+    class HarmonicCrossfade final : public HarmonicStage<SampleType>
+    {
+    public:
+        using Ramp = BlockRamp<SampleType>;
+
+        void prepare(double sampleRate) noexcept
+        {
+            length = juce::jmax(1, juce::roundToInt(0.03 * sampleRate));
+            remaining = 0;
+        }
+
+        void start() noexcept { remaining = length; }
+        void cancel() noexcept { remaining = 0; }
+        bool isFading() const noexcept { return remaining > 0; }
+
+        /*  The engine fading out, scratch for its sum and the gain that brings
+            that sum to the level of the new layout's.
+        */
+        void setPrevious(HarmonicStage<SampleType>& engine, juce::dsp::AudioBlock<SampleType> scratch,
+                         SampleType gain) noexcept
+        {
+            previous = &engine;
+            previousWet = scratch;
+            relativeGain = gain;
+        }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept override
+        {
+            if (remaining == 0 || previous == nullptr)
+                return;
+
+            const auto numSamples = juce::jmin(remaining, (int)block.getNumSamples());
+            auto fadeBlock = block.getSubBlock(0, (size_t)numSamples);
+
+            previous->setBlock(previousWet, this->distortionAmount, this->taskScheduler);
+            previous->process(fadeBlock, offset);
+
+            auto sums = this->getWet(fadeBlock);
+            auto previousSums = previousWet.getSubsetChannelBlock(0, fadeBlock.getNumChannels())
+                                           .getSubBlock(0, (size_t)numSamples);
+
+            const auto step = SampleType(1) / (SampleType)length;
+            const Ramp fade{ SampleType(1) - (SampleType)remaining * step, step };
+
+            for (size_t ch = 0; ch < fadeBlock.getNumChannels(); ++ch)
+            {
+                auto* previousSum = previousSums.getChannelPointer(ch);
+                juce::FloatVectorOperations::multiply(previousSum, relativeGain, numSamples);
+                ShaperKernels<SampleType>::mix(previousSum, sums.getChannelPointer(ch), sums.getChannelPointer(ch),
+                                               numSamples, fade, SampleType(1));
+            }
+
+            remaining -= numSamples;
+        }
+
+    private:
+        HarmonicStage<SampleType>* previous = nullptr;
+        juce::dsp::AudioBlock<SampleType> previousWet;
+        SampleType relativeGain = 1;
+        int length = 1, remaining = 0;
+    };
+
+    /*  Delays the dry signal in the block by an engine's latency, so it
+        stays aligned with the wet sum.
+    */
+    template <typename SampleType>
+    class DryDelayStage final : public ProcessingStage<SampleType>
+    {
+    public:
+        void prepare(const juce::dsp::ProcessSpec& spec, int latency)
+        {
+            delay.prepare(spec);
+            delay.setMaximumDelayInSamples(juce::jmax(1, latency));
+            delay.setDelay((SampleType)latency);
+        }
+
+        void reset() noexcept { delay.reset(); }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int) noexcept override
+        {
+            juce::dsp::ProcessContextReplacing<SampleType> context(block);
+            delay.process(context);
+        }
+
+    private:
+        juce::dsp::DelayLine<SampleType, juce::dsp::DelayLineInterpolationTypes::None> delay;
+    };
+
+    /*  Blends the dry signal in the block with the wet sum:
+        dry * (1 - w) + wet * wetGain * w.
+    */
+    template <typename SampleType>
+    class HarmonicMix final : public HarmonicStage<SampleType>
+    {
+    public:
+        using Ramp = BlockRamp<SampleType>;
+
+        void setMix(Ramp newDryWet, SampleType newWetGain) noexcept
+        {
+            dryWet = newDryWet;
+            wetGain = newWetGain;
+        }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept override
+        {
+            const auto sums = this->getWet(block);
+            const auto blockDryWet = dryWet.skipped(offset);
+
+            for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+            {
+                auto* data = block.getChannelPointer(ch);
+                ShaperKernels<SampleType>::mix(data, sums.getChannelPointer(ch), data,
+                                               (int)block.getNumSamples(), blockDryWet, wetGain);
+            }
+        }
+
+    private:
+        Ramp dryWet = Ramp::constant(1);
+        SampleType wetGain = 1;
+    };
+}
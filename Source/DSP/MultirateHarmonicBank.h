@@ -0,0 +1,396 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "HarmonicFilterBank.h"
+#include "HarmonicScale.h"
+
+namespace zl
+{
+    /*  The linear-phase half-band FIR behind every 2:1 step of
+        MultirateHarmonicBank.
+
+        All even-offset taps of a half-band filter are zero except the centre
+        one, which is 0.5, so a decimator needs one multiply per symmetric
+        pair of odd-offset taps, and one of an interpolator's two phases is a
+        plain delay. Kaiser-windowed: flat to 0.2 of the higher rate and
+        about -70 dB from 0.3 on.
+    */
+    struct HalfBandDesign
+    {
+        static constexpr int delay = 23;   // centre tap, in samples of the higher rate
+        static constexpr int numTaps = 2 * delay + 1;
+        static constexpr int numPairs = (delay + 1) / 2;
+
+        // the taps at delay ± (2m + 1), m = 0 ... numPairs - 1
+        static std::array<double, numPairs> makeTaps()
+        {
+            std::array<double, numTaps> window;
+            juce::dsp::WindowingFunction<double>::fillWindowingTables(window.data(), (size_t)numTaps,
+                juce::dsp::WindowingFunction<double>::kaiser, false, 7.0);
+
+            std::array<double, numPairs> taps;
+            auto sum = 0.0;
+
+            for (int m = 0; m < numPairs; ++m)
+            {
+                const auto offset = 2 * m + 1;
+                const auto x = juce::MathConstants<double>::halfPi * (double)offset;
+                taps[(size_t)m] = 0.5 * std::sin(x) / x * window[(size_t)(delay + offset)];
+                sum += 2.0 * taps[(size_t)m];
+            }
+
+            // the odd taps carry half the DC gain, the centre tap the other half
+            for (auto& tap : taps)
+                tap *= 0.5 / sum;
+
+            return taps;
+        }
+    };
+
+    /*  Which rate each Harmonic-mode band runs at.
+
+        Level k runs at sampleRate / 2^k. A band goes to the deepest level
+        whose passband still holds its first keptHarmonics harmonics, or
+        everything up to the reference rate's passband if that is less, so
+        no band runs faster than it would at 44.1 kHz. The number of levels
+        is set by the lowest band any root note can produce, which keeps the
+        latency fixed for a given sample rate.
+    */
+    struct MultirateLayout
+    {
+        static constexpr int maxLevels = 5;
+        static constexpr int keptHarmonics = 16;
+        static constexpr double referenceRate = 44100.0;
+        static constexpr double passband = 0.4;   // of a level's rate, see HalfBandDesign
+
+        static int getBandLevel(double sampleRate, double frequency) noexcept
+        {
+            const auto bandwidth = juce::jmin(keptHarmonics * frequency, passband * referenceRate);
+            auto level = 0;
+
+            while (level < maxLevels && passband * sampleRate / (double)(2 << level) >= bandwidth)
+                ++level;
+
+            return level;
+        }
+
+        static int getNumLevels(double sampleRate) noexcept
+        {
+            return getBandLevel(sampleRate, HarmonicScale::getBandFrequency(0, false, 0));
+        }
+
+        // one decimator and one interpolator per level, each delay samples of its higher rate
+        static int getLatency(int numLevels) noexcept
+        {
+            return 2 * HalfBandDesign::delay * ((1 << numLevels) - 1);
+        }
+    };
+
+    /*  Harmonic mode with every band at the lowest rate it needs.
+
+        The input is split into a pyramid of half-band decimated signals.
+        Each level has its own HarmonicFilterBank holding the bands assigned
+        to it by MultirateLayout, with coefficients designed for that level's
+        rate. Going back up, each level's shaped output is delayed so every
+        path has the same latency, and added to the interpolated output of
+        the level below it. Levels below the deepest one in use are skipped.
+
+        The output is delayed by getLatencyInSamples(); the caller delays the
+        dry signal to match, e.g. with a DryDelayStage. Channels are
+        independent, so they may run on different threads.
+    */
+    template <typename SampleType>
+    class MultirateHarmonicBank : public HarmonicStage<SampleType>
+    {
+    public:
+        using Coefficients = typename HarmonicFilterBank<SampleType>::Coefficients;
+
+        void prepare(double sampleRate, int numChannelsToUse, int maxBandsToUse, int maxBlockSize)
+        {
+            numLevels = MultirateLayout::getNumLevels(sampleRate);
+            maxBands = juce::jmax(1, maxBandsToUse);
+
+            const auto designed = HalfBandDesign::makeTaps();
+            for (int m = 0; m < HalfBandDesign::numPairs; ++m)
+            {
+                decimatorTaps[(size_t)m] = (SampleType)designed[(size_t)m];
+                interpolatorTaps[(size_t)m] = (SampleType)(2.0 * designed[(size_t)m]);
+            }
+
+            for (int level = 0; level <= numLevels; ++level)
+                banks[(size_t)level].prepare(numChannelsToUse, maxBands);
+
+            channels.resize((size_t)juce::jmax(1, numChannelsToUse));
+            for (auto& channel : channels)
+            {
+                for (int level = 0; level <= numLevels; ++level)
+                {
+                    auto& l = channel.levels[(size_t)level];
+                    const auto capacity = (size_t)((juce::jmax(1, maxBlockSize) >> level) + 2);
+
+                    l.input.resize(level > 0 ? capacity : 0);
+                    l.output.resize(level > 0 ? capacity : 0);
+                    l.decimatorHistory.resize(level > 0 ? 2 * (size_t)HalfBandDesign::numTaps : 0);
+                    l.interpolatorHistory.resize(level > 0 ? 2 * (size_t)(HalfBandDesign::delay + 1) : 0);
+
+                    // what this level needs on top of its own path to match the deepest one
+                    l.pad.resize((size_t)(HalfBandDesign::delay * ((2 << (numLevels - level)) - 2)));
+                }
+            }
+
+            levelBands.fill(0);
+            numActiveBands = 0;
+            deepestLevel = -1;
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            for (int level = 0; level <= numLevels; ++level)
+                banks[(size_t)level].reset();
+
+            for (auto& channel : channels)
+            {
+                for (auto& l : channel.levels)
+                {
+                    for (auto* state : { &l.decimatorHistory, &l.interpolatorHistory, &l.pad })
+                        std::fill(state->begin(), state->end(), SampleType(0));
+
+                    l.decimatorPosition = l.interpolatorPosition = l.padPosition = 0;
+                    l.decimatorPhase = l.interpolatorPhase = 0;
+                }
+            }
+        }
+
+        /*  The bands of a HarmonicConfiguration: each band's level and its
+            coefficients at that level's rate. Filter state is untouched.
+        */
+        void setBands(const std::vector<int>& levels, const std::vector<Coefficients>& coefficients,
+                      int numBands) noexcept
+        {
+            jassert(levels.size() == coefficients.size());
+            numBands = juce::jlimit(0, juce::jmin(maxBands, (int)levels.size()), numBands);
+            levelBands.fill(0);
+
+            for (int band = 0; band < numBands; ++band)
+            {
+                const auto level = juce::jlimit(0, numLevels, levels[(size_t)band]);
+                banks[(size_t)level].setBand(levelBands[(size_t)level]++, coefficients[(size_t)band]);
+            }
+
+            deepestLevel = -1;
+            for (int level = 0; level <= numLevels; ++level)
+            {
+                banks[(size_t)level].setNumActiveBands(levelBands[(size_t)level]);
+
+                if (levelBands[(size_t)level] > 0)
+                    deepestLevel = level;
+            }
+
+            numActiveBands = numBands;
+        }
+
+        int getNumActiveBands() const noexcept { return numActiveBands; }
+        int getNumLevels() const noexcept { return numLevels; }
+        int getLatencyInSamples() const noexcept { return MultirateLayout::getLatency(numLevels); }
+
+        size_t getSizeInBytes() const noexcept
+        {
+            size_t bytes = 0;
+
+            for (const auto& bank : banks)
+                bytes += bank.getSizeInBytes();
+
+            for (const auto& channel : channels)
+                for (const auto& l : channel.levels)
+                    for (const auto* v : { &l.input, &l.output, &l.decimatorHistory, &l.interpolatorHistory, &l.pad })
+                        bytes += v->size() * sizeof(SampleType);
+
+            return bytes;
+        }
+
+        void setPrecision(MathPrecision newPrecision) noexcept
+        {
+            for (auto& bank : banks)
+                bank.setPrecision(newPrecision);
+        }
+
+        void processChannels(const SampleType* const* input, SampleType* const* output,
+                             int numChannelsToProcess, int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            for (int ch = 0; ch < numChannelsToProcess; ++ch)
+                process(ch, input[ch], output[ch], numSamples, amount);
+        }
+
+        // the same, one task per channel
+        template <typename Scheduler>
+        void processChannelsParallel(const SampleType* const* input, SampleType* const* output,
+                                     int numChannelsToProcess, int numSamples, BlockRamp<SampleType> amount,
+                                     Scheduler& scheduler)
+        {
+            scheduler.parallelFor(numChannelsToProcess, [&](int ch)
+            {
+                process(ch, input[ch], output[ch], numSamples, amount);
+            });
+        }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept override
+        {
+            this->runBank(*this, block, offset);
+        }
+
+        /*  Writes the summed, saturated bands of one channel to `output`,
+            getLatencyInSamples() late.
+        */
+        void process(int channelIndex, const SampleType* input, SampleType* output,
+                     int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channelIndex, (int)channels.size()));
+            auto& channel = channels[(size_t)channelIndex];
+
+            if (deepestLevel < 0)
+            {
+                std::fill(output, output + numSamples, SampleType(0));
+                return;
+            }
+
+            std::array<const SampleType*, MultirateLayout::maxLevels + 1> inputs;
+            std::array<int, MultirateLayout::maxLevels + 1> counts;
+            inputs[0] = input;
+            counts[0] = numSamples;
+
+            for (int level = 1; level <= deepestLevel; ++level)
+            {
+                auto& l = channel.levels[(size_t)level];
+                counts[(size_t)level] = decimate(l, inputs[(size_t)level - 1], counts[(size_t)level - 1]);
+                inputs[(size_t)level] = l.input.data();
+            }
+
+            for (int level = deepestLevel; level >= 0; --level)
+            {
+                auto& l = channel.levels[(size_t)level];
+                auto* levelOutput = level == 0 ? output : l.output.data();
+                const auto count = counts[(size_t)level];
+
+                if (levelBands[(size_t)level] > 0)
+                {
+                    // the ramp advances 2^level host samples per sample at this level
+                    const BlockRamp<SampleType> levelAmount{ amount.start, amount.increment * (SampleType)(1 << level) };
+                    banks[(size_t)level].process(channelIndex, inputs[(size_t)level], levelOutput, count, levelAmount);
+                    delay(l, levelOutput, count);
+                }
+                else
+                {
+                    std::fill(levelOutput, levelOutput + count, SampleType(0));
+                }
+
+                if (level < deepestLevel)
+                    interpolateAdding(channel.levels[(size_t)level + 1], levelOutput, count);
+            }
+        }
+
+    private:
+        // the state between level k - 1 and k, stored with level k
+        struct Level
+        {
+            std::vector<SampleType> input, output;   // this level's signals for the current block
+            std::vector<SampleType> decimatorHistory, interpolatorHistory, pad;   // doubled rings, and a ring
+            int decimatorPosition = 0, interpolatorPosition = 0, padPosition = 0;
+            int decimatorPhase = 0, interpolatorPhase = 0;
+        };
+
+        struct Channel
+        {
+            std::array<Level, MultirateLayout::maxLevels + 1> levels;
+        };
+
+        // keeps every other sample of the filtered higher-rate signal; returns the count
+        int decimate(Level& l, const SampleType* input, int numSamples) noexcept
+        {
+            constexpr auto size = HalfBandDesign::numTaps;
+            constexpr auto centre = HalfBandDesign::delay;
+            auto* output = l.input.data();
+            auto count = 0;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                l.decimatorHistory[(size_t)l.decimatorPosition] = input[i];
+                l.decimatorHistory[(size_t)(l.decimatorPosition + size)] = input[i];
+                l.decimatorPosition = l.decimatorPosition + 1 == size ? 0 : l.decimatorPosition + 1;
+
+                l.decimatorPhase ^= 1;
+                if (l.decimatorPhase == 0)
+                    continue;
+
+                // oldest sample first, newest at size - 1
+                const auto* w = l.decimatorHistory.data() + l.decimatorPosition;
+                auto sum = SampleType(0.5) * w[centre];
+
+                for (int m = 0; m < HalfBandDesign::numPairs; ++m)
+                    sum += decimatorTaps[(size_t)m] * (w[centre - 2 * m - 1] + w[centre + 2 * m + 1]);
+
+                output[count++] = sum;
+            }
+
+            return count;
+        }
+
+        // adds the lower level's output, brought back up to this rate, to `output`
+        void interpolateAdding(Level& l, SampleType* output, int numSamples) noexcept
+        {
+            constexpr auto size = HalfBandDesign::delay + 1;
+            constexpr auto half = size / 2;
+            const auto* input = l.output.data();
+            auto consumed = 0;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                // a new lower-rate sample arrives on the phase the decimator emitted one
+                l.interpolatorPhase ^= 1;
+                if (l.interpolatorPhase == 1)
+                {
+                    l.interpolatorHistory[(size_t)l.interpolatorPosition] = input[consumed];
+                    l.interpolatorHistory[(size_t)(l.interpolatorPosition + size)] = input[consumed];
+                    l.interpolatorPosition = l.interpolatorPosition + 1 == size ? 0 : l.interpolatorPosition + 1;
+                    ++consumed;
+                }
+
+                const auto* w = l.interpolatorHistory.data() + l.interpolatorPosition;
+
+                if (l.interpolatorPhase == 1)
+                {
+                    auto sum = SampleType(0);
+
+                    for (int m = 0; m < HalfBandDesign::numPairs; ++m)
+                        sum += interpolatorTaps[(size_t)m] * (w[half + m] + w[half - 1 - m]);
+
+                    output[i] += sum;
+                }
+                else
+                {
+                    output[i] += w[half];
+                }
+            }
+        }
+
+        void delay(Level& l, SampleType* data, int numSamples) noexcept
+        {
+            const auto length = (int)l.pad.size();
+            if (length == 0)
+                return;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                std::swap(data[i], l.pad[(size_t)l.padPosition]);
+                l.padPosition = l.padPosition + 1 == length ? 0 : l.padPosition + 1;
+            }
+        }
+
+        std::array<HarmonicFilterBank<SampleType>, MultirateLayout::maxLevels + 1> banks;
+        std::array<int, MultirateLayout::maxLevels + 1> levelBands {};
+        std::array<SampleType, HalfBandDesign::numPairs> decimatorTaps {}, interpolatorTaps {};
+        std::vector<Channel> channels;
+
+        int numLevels = 0, maxBands = 0, numActiveBands = 0, deepestLevel = -1;
+    };
+}
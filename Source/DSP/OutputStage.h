@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "ShaperKernels.h"
+#include "StagePipeline.h"
+
+namespace zl
+{
+    /*  Final gain-safety stage, run over all channels after the shaping and
+        dry/wet mix of each sub-block. Both modes give the same output for
+        any split of the block.
+    */
+    template <typename SampleType>
+    class OutputStage : public ProcessingStage<SampleType>
+    {
+    public:
+        enum Mode
+        {
+            Limiter = 0,
+            SoftClip
+        };
+
+        // the limiter's release; its threshold stays at the JUCE default
+        static constexpr double releaseMs = 100.0;
+
+        void prepare(const juce::dsp::ProcessSpec& spec)
+        {
+            limiter.prepare(spec);
+            limiter.setRelease((SampleType)releaseMs);
+            reset();
+        }
+
+        void reset()
+        {
+            limiter.reset();
+        }
+
+        void setMode(int newMode) noexcept
+        {
+            // the limiter's envelope is stale after running the soft clipper
+            if (newMode != mode && newMode == Limiter)
+                limiter.reset();
+
+            mode = newMode;
+        }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int) noexcept override
+        {
+            if (mode == SoftClip)
+            {
+                const auto numSamples = (int)block.getNumSamples();
+                for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+                {
+                    auto* data = block.getChannelPointer(ch);
+                    ShaperKernels<SampleType>::template process<SoftClipShape<SampleType>>(
+                        data, data, numSamples,
+                        BlockRamp<SampleType>::constant(1), BlockRamp<SampleType>::constant(1));
+                }
+                return;
+            }
+
+            juce::dsp::ProcessContextReplacing<SampleType> ctx(block);
+            limiter.process(ctx);
+        }
+
+    private:
+        juce::dsp::Limiter<SampleType> limiter;
+        int mode = Limiter;
+    };
+}
@@ -0,0 +1,316 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "ShaperKernels.h"
+
+namespace zl
+{
+    /*  Runs a shaper at 1x–16x through cascaded polyphase half-band
+        filters (juce::dsp::Oversampling), with either the minimum-phase IIR or
+        the linear-phase FIR design.
+
+        Only the non-linear shaping is oversampled: the dry signal is delayed by
+        the oversampler's (integer) latency and mixed back in at the host rate,
+        so dry/wet stays phase-aligned. prepare() builds only the combination
+        the current settings use; any other is built by prepareConfiguration()
+        off the audio thread once it is asked for, so switching at runtime
+        never allocates. Until it is there, asking for it keeps the current
+        setting.
+
+        A new setting fades in over 30 ms while the previous one keeps running
+        and fades out. Every built configuration keeps its dry delay fed while
+        it isn't in use, so the one fading in mixes in the dry signal from its
+        first sample rather than its delay's silence. Stateful shapers therefore see channel indices up to
+        numChannelSets * numChannels, one set per configuration, and must be
+        prepared for that many.
+
+        As a pipeline stage it runs the ShapingStage and ramps given for the
+        current block.
+    */
+    template <typename SampleType>
+    class OversampledShaper : public ProcessingStage<SampleType>
+    {
+    public:
+        using Ramp = BlockRamp<SampleType>;
+
+        enum FilterType
+        {
+            MinimumPhase = 0,
+            LinearPhase,
+            numFilterTypes
+        };
+
+        static constexpr int maxFactorIndex = 4;   // 2^4 = 16x
+        static constexpr int numChannelSets = 2;
+
+        void prepare(const juce::dsp::ProcessSpec& newSpec, int initialFactorIndex, int initialFilterType)
+        {
+            spec = newSpec;
+            numChannels = spec.numChannels;
+
+            for (auto& type : built)
+                for (auto& flag : type)
+                    flag.store(false, std::memory_order_release);
+
+            for (auto& type : engines)
+                for (auto& engine : type)
+                    engine.reset();
+
+            active = nullptr;
+            factorIndex = 0;
+            filterType = MinimumPhase;
+            latency = 0;
+            channelSet = 0;
+
+            // the delayed dry signal, and the outgoing configuration's input copy and delayed dry signal
+            dryBuffer.setSize((int)spec.numChannels, (int)spec.maximumBlockSize);
+            fadeBuffer.setSize(2 * (int)spec.numChannels, (int)spec.maximumBlockSize);
+            fadeLength = juce::jmax(1, juce::roundToInt(0.03 * spec.sampleRate));
+
+            prepareConfiguration(initialFactorIndex, initialFilterType);
+            setConfiguration(initialFactorIndex, initialFilterType);
+            reset();
+        }
+
+        /*  Builds one combination if it isn't there yet. Any thread but the
+            audio thread, after prepare() and never at the same time as it;
+            the audio thread doesn't look at it until this returns.
+        */
+        void prepareConfiguration(int index, int type)
+        {
+            index = juce::jlimit(0, maxFactorIndex, index);
+            type = juce::jlimit(0, numFilterTypes - 1, type);
+
+            if (! isAvailable(index, type))
+                build(type, index);
+        }
+
+        // any thread
+        bool isAvailable(int index, int type) const noexcept
+        {
+            index = juce::jlimit(0, maxFactorIndex, index);
+            type = juce::jlimit(0, numFilterTypes - 1, type);
+
+            return index == 0 || built[(size_t)type][(size_t)index - 1].load(std::memory_order_acquire);
+        }
+
+        void reset()
+        {
+            if (active != nullptr)
+                active->oversampling->reset();
+
+            forEachBuilt([](Engine& engine) { engine.dryDelay.reset(); });
+
+            previous = nullptr;
+            fadeRemaining = 0;
+        }
+
+        /*  Selects the oversampling factor (0 = 1x ... 4 = 16x) and filter design.
+            The newly selected filters start from a clean state and fade in,
+            with their dry delay already holding the input; a change arriving
+            mid-fade waits for the fade to finish.
+        */
+        void setConfiguration(int newFactorIndex, int newFilterType) noexcept
+        {
+            newFactorIndex = juce::jlimit(0, maxFactorIndex, newFactorIndex);
+            newFilterType = juce::jlimit(0, numFilterTypes - 1, newFilterType);
+
+            if (newFactorIndex == factorIndex && newFilterType == filterType)
+                return;
+
+            // at 1x there are no filters to change
+            if (newFactorIndex == 0 && factorIndex == 0)
+            {
+                filterType = newFilterType;
+                return;
+            }
+
+            if (fadeRemaining > 0)
+                return;
+
+            // not built yet: stay with the current filters until prepareConfiguration() is done
+            if (! isAvailable(newFactorIndex, newFilterType))
+                return;
+
+            previous = active;
+            previousFactorIndex = factorIndex;
+            previousChannelSet = channelSet;
+            channelSet = (channelSet + 1) % numChannelSets;
+            fadeRemaining = fadeLength;
+
+            factorIndex = newFactorIndex;
+            filterType = newFilterType;
+            active = factorIndex > 0 ? engines[(size_t)filterType][(size_t)factorIndex - 1].get() : nullptr;
+            latency = active != nullptr ? active->latency : 0;
+
+            if (active != nullptr)
+                active->oversampling->reset();
+        }
+
+        int getFactor() const noexcept { return 1 << factorIndex; }
+        int getLatencyInSamples() const noexcept { return latency; }
+
+        // what process() runs for the current block; the shaper must outlive its use here
+        void setShaper(ShapingStage<SampleType>& newShaper, Ramp newAmount, Ramp newDryWet) noexcept
+        {
+            shaper = &newShaper;
+            amount = newAmount;
+            dryWet = newDryWet;
+        }
+
+        /*  Shapes and mixes `block`, at most maximumBlockSize samples, in
+            place; `offset` is its position within the block the ramps are for.
+        */
+        void process(juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept override
+        {
+            jassert(shaper != nullptr);
+
+            if (shaper == nullptr)
+                return;
+
+            const auto numChannelsToUse = block.getNumChannels();
+            const auto numSamples = block.getNumSamples();
+            const auto blockAmount = amount.skipped(offset);
+            const auto blockDryWet = dryWet.skipped(offset);
+            juce::dsp::AudioBlock<SampleType> dryBlock(dryBuffer);
+            auto dryScratch = dryBlock.getSubsetChannelBlock(0, numChannelsToUse).getSubBlock(0, numSamples);
+
+            feedIdleDryDelays(block, dryScratch);
+
+            if (fadeRemaining == 0)
+            {
+                run(active, factorIndex, channelSet, block, dryScratch, blockAmount, blockDryWet);
+                return;
+            }
+
+            // the outgoing configuration shapes a copy, then fades out under the new one
+            juce::dsp::AudioBlock<SampleType> fadeBlock(fadeBuffer);
+            auto previousBlock = fadeBlock.getSubsetChannelBlock(0, numChannelsToUse).getSubBlock(0, numSamples);
+            auto previousDry = fadeBlock.getSubsetChannelBlock(numChannels, numChannelsToUse).getSubBlock(0, numSamples);
+            previousBlock.copyFrom(block);
+
+            run(previous, previousFactorIndex, previousChannelSet, previousBlock, previousDry, blockAmount, blockDryWet);
+            run(active, factorIndex, channelSet, block, dryScratch, blockAmount, blockDryWet);
+
+            const auto length = juce::jmin(fadeRemaining, (int)numSamples);
+            const auto step = SampleType(1) / (SampleType)fadeLength;
+            const Ramp fade{ SampleType(1) - (SampleType)fadeRemaining * step, step };
+
+            for (size_t ch = 0; ch < numChannelsToUse; ++ch)
+                ShaperKernels<SampleType>::mix(previousBlock.getChannelPointer(ch), block.getChannelPointer(ch),
+                                               block.getChannelPointer(ch), length, fade, SampleType(1));
+
+            fadeRemaining -= length;
+
+            if (fadeRemaining == 0)
+                previous = nullptr;
+        }
+
+    private:
+        // one factor/filter combination, with the dry delay matching its latency
+        struct Engine
+        {
+            std::unique_ptr<juce::dsp::Oversampling<SampleType>> oversampling;
+            juce::dsp::DelayLine<SampleType, juce::dsp::DelayLineInterpolationTypes::None> dryDelay;
+            int latency = 0;
+        };
+
+        void run(Engine* engine, int engineFactorIndex, int set,
+                 juce::dsp::AudioBlock<SampleType>& block, juce::dsp::AudioBlock<SampleType>& dryScratch,
+                 Ramp blockAmount, Ramp blockDryWet) noexcept
+        {
+            const auto numSamples = (int)block.getNumSamples();
+            const auto firstChannel = set * (int)numChannels;
+
+            if (engine == nullptr)
+            {
+                shaper->shape(block, firstChannel, blockAmount, blockDryWet);
+                return;
+            }
+
+            jassert(block.getNumChannels() == numChannels);
+
+            juce::dsp::ProcessContextNonReplacing<SampleType> dryContext(block, dryScratch);
+            engine->dryDelay.process(dryContext);
+
+            auto upsampled = engine->oversampling->processSamplesUp(block);
+            const auto factor = (SampleType)(1 << engineFactorIndex);
+            const Ramp upsampledAmount{ blockAmount.start, blockAmount.increment / factor };
+            shaper->shape(upsampled, firstChannel, upsampledAmount, Ramp::constant(1));
+
+            engine->oversampling->processSamplesDown(block);
+
+            for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+            {
+                auto* data = block.getChannelPointer(ch);
+                ShaperKernels<SampleType>::mix(dryScratch.getChannelPointer(ch), data, data,
+                                               numSamples, blockDryWet, SampleType(1));
+            }
+        }
+
+        template <typename Fn>
+        void forEachBuilt(Fn&& fn)
+        {
+            for (size_t type = 0; type < engines.size(); ++type)
+                for (size_t index = 0; index < engines[type].size(); ++index)
+                    if (built[type][index].load(std::memory_order_acquire))
+                        fn(*engines[type][index]);
+        }
+
+        // keeps the configurations not running in step with the input;
+        // `scratch` is overwritten
+        void feedIdleDryDelays(juce::dsp::AudioBlock<SampleType>& block,
+                               juce::dsp::AudioBlock<SampleType>& scratch) noexcept
+        {
+            if (block.getNumChannels() != numChannels)
+                return;
+
+            juce::dsp::ProcessContextNonReplacing<SampleType> context(block, scratch);
+
+            forEachBuilt([&](Engine& engine)
+            {
+                if (&engine != active && &engine != previous)
+                    engine.dryDelay.process(context);
+            });
+        }
+
+        void build(int type, int index)
+        {
+            auto engine = std::make_unique<Engine>();
+            engine->oversampling = std::make_unique<juce::dsp::Oversampling<SampleType>>(
+                spec.numChannels, (size_t)index,
+                type == LinearPhase ? juce::dsp::Oversampling<SampleType>::filterHalfBandFIREquiripple
+                                    : juce::dsp::Oversampling<SampleType>::filterHalfBandPolyphaseIIR,
+                true, true);
+            engine->oversampling->initProcessing(spec.maximumBlockSize);
+            engine->latency = (int)engine->oversampling->getLatencyInSamples();
+
+            engine->dryDelay.prepare(spec);
+            engine->dryDelay.setMaximumDelayInSamples(juce::jmax(1, engine->latency));
+            engine->dryDelay.setDelay((SampleType)engine->latency);
+
+            engines[(size_t)type][(size_t)index - 1] = std::move(engine);
+            built[(size_t)type][(size_t)index - 1].store(true, std::memory_order_release);
+        }
+
+        std::array<std::array<std::unique_ptr<Engine>, maxFactorIndex>, numFilterTypes> engines;
+        std::array<std::array<std::atomic<bool>, maxFactorIndex>, numFilterTypes> built {};
+        Engine* active = nullptr;
+        int channelSet = 0;
+
+        // the configuration fading out, if any
+        Engine* previous = nullptr;
+        int previousFactorIndex = 0, previousChannelSet = 0;
+        int fadeLength = 1, fadeRemaining = 0;
+        juce::AudioBuffer<SampleType> fadeBuffer;
+
+        ShapingStage<SampleType>* shaper = nullptr;
+        Ramp amount = Ramp::constant(0), dryWet = Ramp::constant(1);
+        juce::AudioBuffer<SampleType> dryBuffer;
+
+        juce::dsp::ProcessSpec spec {};
+
+        juce::uint32 numChannels = 0;
+        int factorIndex = 0, filterType = MinimumPhase, latency = 0;
+    };
+}
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+
+namespace zl
+{
+    /*  Per-instance scratch memory for the audio thread.
+
+        Everything is allocated in prepare() for the announced channel count and
+        maximum block size; getBlock() only hands out views into it. Callers that
+        may see larger host blocks split them into getCapacity()-sized chunks.
+    */
+    template <typename SampleType>
+    class ScratchArena
+    {
+    public:
+        void prepare(int numSlots, int numChannels, int maxBlockSize)
+        {
+            slots.resize((size_t)numSlots);
+            for (auto& slot : slots)
+                slot.setSize(juce::jmax(1, numChannels), juce::jmax(1, maxBlockSize));
+
+            capacity = juce::jmax(1, maxBlockSize);
+        }
+
+        void release()
+        {
+            slots.clear();
+            capacity = 0;
+        }
+
+        int getCapacity() const noexcept { return capacity; }
+
+        size_t getSizeInBytes() const noexcept
+        {
+            size_t bytes = 0;
+
+            for (const auto& slot : slots)
+                bytes += (size_t)(slot.getNumChannels() * slot.getNumSamples()) * sizeof(SampleType);
+
+            return bytes;
+        }
+
+        juce::dsp::AudioBlock<SampleType> getBlock(int slot, size_t numChannels, size_t numSamples) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(slot, (int)slots.size()));
+            jassert((int)numSamples <= capacity);
+
+            return juce::dsp::AudioBlock<SampleType>(slots[(size_t)slot])
+                .getSubsetChannelBlock(0, numChannels)
+                .getSubBlock(0, numSamples);
+        }
+
+    private:
+        std::vector<juce::AudioBuffer<SampleType>> slots;
+        int capacity = 0;
+    };
+}
@@ -0,0 +1,283 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "BlockRamp.h"
+#include "FastMath.h"
+#include "StagePipeline.h"
+#include <cmath>
+#include <cstring>
+
+namespace zl
+{
+    /*  Transfer functions for the non-harmonic distortion modes.
+
+        Each shape provides the original per-sample expression as `reference`,
+        and a branch-free `vector` form that shapes a whole SIMDRegister at once.
+    */
+    template <typename SampleType>
+    struct HardClipShape
+    {
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+        static SampleType reference(SampleType x, SampleType amount) noexcept
+        {
+            return juce::jlimit(SampleType(-0.5), SampleType(0.5), x * amount);
+        }
+
+        static Vec vector(Vec x, Vec amount) noexcept
+        {
+            return Vec::min(Vec::max(x * amount, Vec(SampleType(-0.5))), Vec(SampleType(0.5)));
+        }
+    };
+
+    template <typename SampleType>
+    struct FoldbackShape
+    {
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+        static SampleType reference(SampleType x, SampleType amount) noexcept
+        {
+            auto shaped = x;
+            if (x > SampleType(0.5) || x < SampleType(-0.5))
+                shaped = std::abs(std::fmod(x - SampleType(0.5), SampleType(1)) - SampleType(0.5));
+            return shaped * amount;
+        }
+
+        static Vec vector(Vec x, Vec amount) noexcept
+        {
+            // fmod(y, 1) == y - trunc(y), which keeps the sign of y like std::fmod does
+            const Vec half(SampleType(0.5));
+            const auto y = x - half;
+            const auto folded = Vec::abs(y - Vec::truncate(y) - half);
+            const auto outside = Vec::greaterThan(Vec::abs(x), half);
+            return (x + ((folded - x) & outside)) * amount;
+        }
+    };
+
+    /*  `precision` picks std::exp or one of the FastMath approximations. */
+    template <typename SampleType, MathPrecision precision = MathPrecision::Exact>
+    struct ExponentialShape
+    {
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+        static SampleType reference(SampleType x, SampleType amount) noexcept
+        {
+            return std::copysign(SampleType(1), x) * (SampleType(1) - std::exp(-std::abs(x * amount)));
+        }
+
+        static Vec vector(Vec x, Vec amount) noexcept
+        {
+            const auto decay = FastMath::expOfMinus<precision>(Vec::abs(x) * amount);
+            const auto magnitude = Vec(SampleType(1)) - decay;
+            const auto negative = Vec::lessThan(x, Vec(SampleType(0)));
+            return magnitude - ((magnitude + magnitude) & negative);
+        }
+    };
+
+    template <typename SampleType>
+    struct BitCrushShape
+    {
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+        static SampleType reference(SampleType x, SampleType) noexcept
+        {
+            return std::round(x * SampleType(8)) / SampleType(8);
+        }
+
+        static Vec vector(Vec x, Vec) noexcept
+        {
+            // round half away from zero: trunc(y + copysign(0.5, y))
+            const auto y = x * SampleType(8);
+            const auto negative = Vec::lessThan(y, Vec(SampleType(0)));
+            const auto half = Vec(SampleType(0.5)) - (Vec(SampleType(1)) & negative);
+            return Vec::truncate(y + half) * SampleType(0.125);
+        }
+    };
+
+    template <typename SampleType>
+    struct WavefoldShape
+    {
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+        static SampleType reference(SampleType x, SampleType amount) noexcept
+        {
+            auto shaped = x;
+            if (x > SampleType(0.5))       shaped = SampleType(1) - (x - SampleType(0.5));
+            else if (x < SampleType(-0.5)) shaped = SampleType(-1) - (x + SampleType(0.5));
+            return shaped * amount;
+        }
+
+        static Vec vector(Vec x, Vec amount) noexcept
+        {
+            const Vec half(SampleType(0.5)), threeHalves(SampleType(1.5));
+            const auto twoX = x + x;
+            const auto above = Vec::greaterThan(x, half);
+            const auto below = Vec::lessThan(x, Vec(SampleType(-0.5)));
+            const auto shaped = x + ((threeHalves - twoX) & above)
+                                  - ((threeHalves + twoX) & below);
+            return shaped * amount;
+        }
+    };
+
+    /*  Cubic soft clipper used by the output stage: unity slope at zero, reaching
+        exactly ±1 with zero slope at ±1.5 and flat beyond.
+    */
+    template <typename SampleType>
+    struct SoftClipShape
+    {
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+        static SampleType reference(SampleType x, SampleType) noexcept
+        {
+            x = juce::jlimit(SampleType(-1.5), SampleType(1.5), x);
+            return x - SampleType(4.0 / 27.0) * x * x * x;
+        }
+
+        static Vec vector(Vec x, Vec) noexcept
+        {
+            x = Vec::min(Vec::max(x, Vec(SampleType(-1.5))), Vec(SampleType(1.5)));
+            return x - x * x * x * SampleType(4.0 / 27.0);
+        }
+    };
+
+    //==============================================================================
+    /*  Whole-block shaping + dry/wet kernels.
+
+        The kernel for a mode is picked once per block, so the inner loop has no
+        mode branch and shapes SIMDNumElements samples per iteration. Amount and
+        dry/wet arrive as block ramps and are advanced in-register. `input` and
+        `output` may alias. The reference kernels run the original scalar
+        expressions and exist so the vector path can be checked against them.
+    */
+    template <typename SampleType>
+    struct ShaperKernels
+    {
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+        using Ramp = BlockRamp<SampleType>;
+        using Kernel = void (*)(const SampleType* input, SampleType* output, int numSamples,
+                                Ramp amount, Ramp dryWet);
+
+        static constexpr int width = (int)Vec::SIMDNumElements;
+
+        template <typename Shape>
+        static void process(const SampleType* input, SampleType* output, int numSamples,
+                            Ramp amount, Ramp dryWet) noexcept
+        {
+            const auto amountOffsets = laneOffsets(amount);
+            const auto wetOffsets = laneOffsets(dryWet);
+
+            int i = 0;
+            for (; i + width <= numSamples; i += width)
+            {
+                const auto dry = load(input + i);
+                const auto amountV = Vec(amount[i]) + amountOffsets;
+                const auto wetV = Vec(dryWet[i]) + wetOffsets;
+                store(output + i, dry + (Shape::vector(dry, amountV) - dry) * wetV);
+            }
+
+            // run the remainder through a padded register so every sample takes the same path
+            if (const auto remaining = numSamples - i; remaining > 0)
+            {
+                Vec dry(SampleType(0));
+                std::memcpy(&dry.value, input + i, sizeof(SampleType) * (size_t)remaining);
+                const auto amountV = Vec(amount[i]) + amountOffsets;
+                const auto wetV = Vec(dryWet[i]) + wetOffsets;
+                const auto mixed = dry + (Shape::vector(dry, amountV) - dry) * wetV;
+                std::memcpy(output + i, &mixed.value, sizeof(SampleType) * (size_t)remaining);
+            }
+        }
+
+        template <typename Shape>
+        static void processReference(const SampleType* input, SampleType* output, int numSamples,
+                                     Ramp amount, Ramp dryWet) noexcept
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto dry = input[i];
+                const auto wet = dryWet[i];
+                output[i] = dry * (SampleType(1) - wet) + Shape::reference(dry, amount[i]) * wet;
+            }
+        }
+
+        /*  Dry/wet blend of an already shaped signal:
+            output = dry * (1 - w) + wet * w * wetGain, with w following the ramp.
+            `output` may alias either input.
+        */
+        static void mix(const SampleType* dry, const SampleType* wet, SampleType* output,
+                        int numSamples, Ramp dryWet, SampleType wetGain) noexcept
+        {
+            const auto wetOffsets = laneOffsets(dryWet);
+            const Vec gain(wetGain);
+
+            int i = 0;
+            for (; i + width <= numSamples; i += width)
+            {
+                const auto d = load(dry + i);
+                const auto wetV = Vec(dryWet[i]) + wetOffsets;
+                store(output + i, d + (load(wet + i) * gain - d) * wetV);
+            }
+
+            for (; i < numSamples; ++i)
+            {
+                const auto w = dryWet[i];
+                output[i] = dry[i] * (SampleType(1) - w) + wet[i] * wetGain * w;
+            }
+        }
+
+        //==============================================================================
+        // building blocks for shapers that keep state between calls
+
+        /*  {0, 1, ... width - 1} * increment, added to a broadcast ramp[i] so
+            long blocks don't accumulate rounding error.
+        */
+        static Vec laneOffsets(Ramp ramp) noexcept
+        {
+            Vec v;
+            for (size_t lane = 0; lane < Vec::SIMDNumElements; ++lane)
+                v.set(lane, ramp.increment * (SampleType)lane);
+            return v;
+        }
+
+        static Vec load(const SampleType* source) noexcept
+        {
+            Vec v;
+            std::memcpy(&v.value, source, sizeof(v.value));
+            return v;
+        }
+
+        static void store(SampleType* dest, const Vec& v) noexcept
+        {
+            std::memcpy(dest, &v.value, sizeof(v.value));
+        }
+    };
+
+    /*  The memoryless shapers as a ShapingStage: runs the kernel picked for
+        the block over every channel. Without a kernel the block passes
+        through unchanged.
+    */
+    template <typename SampleType>
+    class KernelShaper final : public ShapingStage<SampleType>
+    {
+    public:
+        using Kernel = typename ShaperKernels<SampleType>::Kernel;
+        using Ramp = BlockRamp<SampleType>;
+
+        void setKernel(Kernel newKernel) noexcept { kernel = newKernel; }
+
+        void shape(juce::dsp::AudioBlock<SampleType>& block, int,
+                   Ramp amount, Ramp dryWet) noexcept override
+        {
+            if (kernel == nullptr)
+                return;
+
+            for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+            {
+                auto* data = block.getChannelPointer(ch);
+                kernel(data, data, (int)block.getNumSamples(), amount, dryWet);
+            }
+        }
+
+    private:
+        Kernel kernel = nullptr;
+    };
+}
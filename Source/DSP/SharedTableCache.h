@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+
+namespace zl
+{
+    /*  Process-wide store of immutable DSP tables: every instance asking for
+        the same key gets the same copy.
+
+        The cache holds weak references only, so a table lives as long as
+        someone keeps the shared_ptr get() returned, and is built again the
+        next time it is asked for after that. Thread-safe, but get() may
+        build, so it must not be called from the audio thread. Hold the cache
+        itself with a juce::SharedResourcePointer.
+
+        Table needs getSizeInBytes(), Key needs operator<.
+    */
+    template <typename Key, typename Table>
+    class SharedTableCache
+    {
+    public:
+        /*  The table for `key`. If nobody holds one, build() is called
+            (under the cache's lock) and must return a std::unique_ptr<Table>.
+        */
+        template <typename Builder>
+        std::shared_ptr<const Table> get(const Key& key, Builder&& build)
+        {
+            const juce::ScopedLock sl(lock);
+
+            for (auto it = tables.begin(); it != tables.end();)
+                it = it->second.expired() ? tables.erase(it) : std::next(it);
+
+            auto& entry = tables[key];
+
+            if (auto table = entry.lock())
+                return table;
+
+            std::shared_ptr<const Table> table = build();
+            entry = table;
+            return table;
+        }
+
+        struct Usage
+        {
+            size_t bytes = 0;           // every live table once
+            size_t unsharedBytes = 0;   // what the same users would hold with a copy each
+            int numTables = 0;
+        };
+
+        Usage getUsage() const
+        {
+            const juce::ScopedLock sl(lock);
+            Usage usage;
+
+            for (const auto& entry : tables)
+            {
+                if (const auto table = entry.second.lock())
+                {
+                    const auto size = table->getSizeInBytes();
+                    usage.bytes += size;
+                    usage.unsharedBytes += size * (size_t)(table.use_count() - 1);   // not counting `table`
+                    ++usage.numTables;
+                }
+            }
+
+            return usage;
+        }
+
+    private:
+        std::map<Key, std::weak_ptr<const Table>> tables;
+        juce::CriticalSection lock;
+    };
+}
@@ -0,0 +1,368 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "BlockRamp.h"
+#include "SharedTableCache.h"
+#include "HarmonicStage.h"
+
+namespace zl
+{
+    // the bins one band passes, and how much of each
+    struct SpectralBand
+    {
+        int firstBin = 0;
+        std::vector<float> weights;
+    };
+
+    struct SpectralLayout
+    {
+        // frames of about 43 ms at any rate: 2048 samples at 48 kHz, 8192 at 192 kHz
+        static int getOrder(double sampleRate) noexcept
+        {
+            return juce::jlimit(9, 14, (int)std::ceil(std::log2(sampleRate * 0.04)));
+        }
+
+        /*  Samples the magnitude response of a biquad (b0, b1, b2, a1, a2) at
+            every bin of a 2^order FFT and keeps the run of bins around the
+            peak that pass more than -40 dB.
+        */
+        static SpectralBand makeBand(const std::array<double, 5>& c, int order)
+        {
+            const auto numBins = (1 << order) / 2 + 1;
+            std::vector<float> magnitudes((size_t)numBins);
+
+            for (int k = 0; k < numBins; ++k)
+            {
+                const auto w = juce::MathConstants<double>::pi * (double)k / (double)(numBins - 1);
+                const auto z1 = std::polar(1.0, -w), z2 = z1 * z1;
+                magnitudes[(size_t)k] = (float)std::abs((c[0] + c[1] * z1 + c[2] * z2) / (1.0 + c[3] * z1 + c[4] * z2));
+            }
+
+            const auto peak = (int)(std::max_element(magnitudes.begin(), magnitudes.end()) - magnitudes.begin());
+            auto first = peak, last = peak;
+
+            while (first > 0 && magnitudes[(size_t)first - 1] > 0.01f) --first;
+            while (last < numBins - 1 && magnitudes[(size_t)last + 1] > 0.01f) ++last;
+
+            return { first, { magnitudes.begin() + first, magnitudes.begin() + last + 1 } };
+        }
+    };
+
+    // the periodic Hann window of one frame, the same for every instance
+    struct SpectralWindow
+    {
+        using Cache = SharedTableCache<int, SpectralWindow>;   // keyed by FFT order
+
+        std::vector<float> samples;
+
+        static std::unique_ptr<SpectralWindow> build(int order)
+        {
+            auto window = std::make_unique<SpectralWindow>();
+            const auto size = 1 << order;
+            window->samples.resize((size_t)size);
+
+            for (int i = 0; i < size; ++i)
+                window->samples[(size_t)i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * (float)i / (float)size);
+
+            return window;
+        }
+
+        size_t getSizeInBytes() const noexcept { return sizeof(*this) + samples.size() * sizeof(float); }
+    };
+
+    /*  Harmonic mode in the frequency domain: the same scale-degree bands and
+        exponential saturation as HarmonicFilterBank, at a cost that barely
+        depends on the band count.
+
+        Each channel runs a short-time Fourier transform (periodic Hann, four
+        times overlapped). Per frame, every band's amplitude is measured from
+        its bins, and the saturator's describing function at that amplitude
+        gives the gain of the band's fundamental and the level of its 3rd and
+        5th harmonics. Those are synthesised as windowed partials at three
+        and five times the frequency of the band's strongest partial, so
+        overlap-add puts them back together without frame-rate ripple. One
+        forward and one inverse FFT per hop serve every band; a band adds a
+        few operations per bin it covers.
+
+        This is an approximation of the filter bank: the saturation follows
+        the band's envelope frame by frame instead of shaping every sample,
+        and only the 3rd and 5th harmonics are generated. The output is
+        delayed by getLatencyInSamples(); process() hands out the dry input
+        delayed by the same amount. As a pipeline stage it writes that
+        delayed dry signal back into the block.
+    */
+    template <typename SampleType>
+    class SpectralHarmonicBank : public HarmonicStage<SampleType>
+    {
+    public:
+        void prepare(double sampleRate, int numChannelsToUse)
+        {
+            order = SpectralLayout::getOrder(sampleRate);
+            size = 1 << order;
+            hop = size / 4;
+            fft = std::make_unique<juce::dsp::FFT>(order);
+
+            const auto windowOrder = order;
+            window = windowCache->get(windowOrder, [windowOrder] { return SpectralWindow::build(windowOrder); });
+
+            channels.resize((size_t)juce::jmax(1, numChannelsToUse));
+            for (auto& channel : channels)
+            {
+                channel.input.resize((size_t)size);
+                channel.output.resize((size_t)size);
+                channel.frame.resize((size_t)size * 2);
+                channel.spectrum.resize((size_t)size / 2 + 1);
+            }
+
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            for (auto& channel : channels)
+            {
+                std::fill(channel.input.begin(), channel.input.end(), SampleType(0));
+                std::fill(channel.output.begin(), channel.output.end(), SampleType(0));
+                channel.position = 0;
+                channel.hopCounter = 0;
+            }
+        }
+
+        /*  The first numBandsToUse bands of a HarmonicConfiguration built for
+            this sample rate. The vector must outlive its use here; nullptr
+            mutes the engine.
+        */
+        void setBands(const std::vector<SpectralBand>* newBands, int numBandsToUse, int bandsOrder) noexcept
+        {
+            jassert(newBands == nullptr || bandsOrder == order);
+            bands = bandsOrder == order ? newBands : nullptr;
+            numBands = bands != nullptr ? juce::jlimit(0, (int)bands->size(), numBandsToUse) : 0;
+        }
+
+        int getLatencyInSamples() const noexcept { return size; }
+
+        // this instance's buffers; the window is shared
+        size_t getSizeInBytes() const noexcept
+        {
+            size_t bytes = 0;
+
+            for (const auto& channel : channels)
+                bytes += (channel.input.size() + channel.output.size()) * sizeof(SampleType)
+                       + channel.frame.size() * sizeof(float)
+                       + channel.spectrum.size() * sizeof(std::complex<float>);
+
+            return bytes;
+        }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept override
+        {
+            auto sums = this->getWet(block);
+            const auto numSamples = (int)block.getNumSamples();
+            const auto blockAmount = this->distortionAmount.skipped(offset);
+
+            auto runChannel = [&](int ch)
+            {
+                auto* data = block.getChannelPointer((size_t)ch);
+                process(ch, data, sums.getChannelPointer((size_t)ch), data, numSamples, blockAmount);
+            };
+
+            if (this->taskScheduler != nullptr)
+                this->taskScheduler->parallelFor((int)block.getNumChannels(), runChannel);
+            else
+                for (int ch = 0; ch < (int)block.getNumChannels(); ++ch)
+                    runChannel(ch);
+        }
+
+        /*  Writes the summed, saturated bands to `wet` and the input delayed
+            by the same latency to `delayedDry`, which may alias `input`.
+            Channels are independent, so they may run on different threads.
+        */
+        void process(int channelIndex, const SampleType* input, SampleType* wet, SampleType* delayedDry,
+                     int numSamples, BlockRamp<SampleType> amount) noexcept
+        {
+            jassert(juce::isPositiveAndBelow(channelIndex, (int)channels.size()));
+            auto& channel = channels[(size_t)channelIndex];
+            const auto mask = size - 1;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const auto position = channel.position;
+                const auto x = input[i];
+
+                // the slot being overwritten holds the input from `size` samples ago
+                delayedDry[i] = channel.input[(size_t)position];
+                channel.input[(size_t)position] = x;
+
+                wet[i] = channel.output[(size_t)position];
+                channel.output[(size_t)position] = SampleType(0);
+
+                channel.position = (position + 1) & mask;
+
+                if (++channel.hopCounter == hop)
+                {
+                    channel.hopCounter = 0;
+                    processFrame(channel, (float)amount[i]);
+                }
+            }
+        }
+
+    private:
+        struct Channel
+        {
+            // rings of one frame, oldest sample at `position`; at the host's
+            // precision, so the delayed dry signal comes out bit-exact
+            std::vector<SampleType> input, output;
+            std::vector<float> frame;           // FFT workspace, 2 * size; juce::dsp::FFT is float only
+            std::vector<std::complex<float>> spectrum;
+            int position = 0, hopCounter = 0;
+        };
+
+        void processFrame(Channel& channel, float amount) noexcept
+        {
+            const auto mask = size - 1;
+            auto* frame = channel.frame.data();
+            const auto* windowSamples = window->samples.data();
+
+            for (int i = 0; i < size; ++i)
+                frame[i] = (float)channel.input[(size_t)((channel.position + i) & mask)] * windowSamples[i];
+
+            fft->performRealOnlyForwardTransform(frame, true);
+
+            const auto* bins = reinterpret_cast<const std::complex<float>*>(frame);
+            auto* spectrum = channel.spectrum.data();
+            const auto numBins = size / 2 + 1;
+            std::fill(spectrum, spectrum + numBins, std::complex<float>());
+
+            for (int band = 0; band < numBands; ++band)
+                addBand((*bands)[(size_t)band], bins, spectrum, numBins, amount);
+
+            std::copy(spectrum, spectrum + numBins, reinterpret_cast<std::complex<float>*>(frame));
+            fft->performRealOnlyInverseTransform(frame);
+
+            // Hann analysis and synthesis windows overlap-add to 1.5 at a quarter-frame hop
+            constexpr auto overlapGain = 1.0f / 1.5f;
+
+            for (int i = 0; i < size; ++i)
+                channel.output[(size_t)((channel.position + i) & mask)] += (SampleType)(frame[i] * windowSamples[i] * overlapGain);
+        }
+
+        void addBand(const SpectralBand& band, const std::complex<float>* bins, std::complex<float>* spectrum,
+                     int numBins, float amount) const noexcept
+        {
+            const auto numWeights = (int)band.weights.size();
+            auto energy = 0.0f, peakEnergy = 0.0f;
+            auto peak = band.firstBin;
+
+            for (int i = 0; i < numWeights; ++i)
+            {
+                const auto binEnergy = band.weights[(size_t)i] * band.weights[(size_t)i] * std::norm(bins[band.firstBin + i]);
+                energy += binEnergy;
+
+                if (binEnergy > peakEnergy)
+                {
+                    peakEnergy = binEnergy;
+                    peak = band.firstBin + i;
+                }
+            }
+
+            // peak amplitude of the band signal; a Hann-windowed sine of
+            // amplitude A has sum |X|^2 = 3 N^2 A^2 / 32 over the positive bins
+            const auto amplitude = std::sqrt(energy * 32.0f / (3.0f * (float)size * (float)size));
+            if (amplitude < 1.0e-9f)
+                return;
+
+            const auto harmonics = describe(amount * amplitude);
+            const auto fundamentalGain = harmonics[0] / amplitude;
+
+            // the fundamental is a plain gain on every bin of the band
+            for (int i = 0; i < numWeights; ++i)
+            {
+                const auto k = band.firstBin + i;
+                spectrum[k] += band.weights[(size_t)i] * bins[k] * fundamentalGain;
+            }
+
+            if (peak <= 0 || peak >= numBins - 1)
+                return;
+
+            // the band's strongest partial: frequency from a parabola through
+            // the log magnitudes around the peak, phase at the frame start
+            // with the window's offset-dependent rotation taken out
+            const auto below = std::log(std::abs(bins[peak - 1]) + 1.0e-20f);
+            const auto centre = std::log(std::abs(bins[peak]) + 1.0e-20f);
+            const auto above = std::log(std::abs(bins[peak + 1]) + 1.0e-20f);
+            const auto curvature = below - 2.0f * centre + above;
+            const auto offset = curvature < 0.0f ? juce::jlimit(-0.5f, 0.5f, 0.5f * (below - above) / curvature) : 0.0f;
+
+            const auto bin = (double)peak + (double)offset;
+            const auto phase = (double)std::arg(bins[peak])
+                             - juce::MathConstants<double>::pi * (double)offset * (double)(size - 1) / (double)size;
+
+            // a sine saturates into sin(n t): cosine phase n * phase + (n - 1) * pi / 2
+            addPartial(spectrum, numBins, 3.0 * bin, harmonics[1], 3.0 * phase + juce::MathConstants<double>::pi);
+            addPartial(spectrum, numBins, 5.0 * bin, harmonics[2], 5.0 * phase);
+        }
+
+        /*  Adds a Hann-windowed cosine of `amplitude`, sitting at the
+            fractional bin `position` with `phase` at the frame start, i.e.
+            exactly what the forward transform would have produced for it.
+        */
+        void addPartial(std::complex<float>* spectrum, int numBins, double position, float amplitude, double phase) const noexcept
+        {
+            const auto nearest = (int)position;
+            const auto rotation = std::polar(0.5 * (double)amplitude, phase);
+
+            for (int k = juce::jmax(0, nearest - 2); k <= juce::jmin(numBins - 1, nearest + 3); ++k)
+            {
+                const auto d = position - (double)k;
+                const auto lobe = 0.5 * geometricSum(d) - 0.25 * (geometricSum(d + 1.0) + geometricSum(d - 1.0));
+                spectrum[k] += std::complex<float>(rotation * lobe);
+            }
+        }
+
+        // sum of exp(i 2 pi x n / N) over one frame, for |x| well below N
+        std::complex<double> geometricSum(double x) const noexcept
+        {
+            const auto n = (double)size;
+            const auto denominator = std::sin(juce::MathConstants<double>::pi * x / n);
+
+            if (std::abs(denominator) < 1.0e-12)
+                return { n, 0.0 };
+
+            return std::polar(std::sin(juce::MathConstants<double>::pi * x) / denominator,
+                              juce::MathConstants<double>::pi * x * (n - 1.0) / n);
+        }
+
+        /*  Amplitudes of the 1st, 3rd and 5th harmonic that
+            sign(x) * (1 - exp(-|x|)) produces from a sine of amplitude u:
+            c_n = 4 / pi * integral over [0, pi/2] of f(u sin t) sin(n t) dt.
+        */
+        static std::array<float, 3> describe(float u) noexcept
+        {
+            constexpr int numPoints = 24;
+            constexpr auto step = juce::MathConstants<float>::halfPi / (float)numPoints;
+            std::array<float, 3> c {};
+
+            for (int i = 0; i < numPoints; ++i)
+            {
+                const auto t = step * ((float)i + 0.5f);
+                const auto f = 1.0f - std::exp(-u * std::sin(t));
+                c[0] += f * std::sin(t);
+                c[1] += f * std::sin(3.0f * t);
+                c[2] += f * std::sin(5.0f * t);
+            }
+
+            for (auto& value : c)
+                value *= step * 4.0f / juce::MathConstants<float>::pi;
+
+            return c;
+        }
+
+        int order = 0, size = 0, hop = 0;
+        std::unique_ptr<juce::dsp::FFT> fft;
+        juce::SharedResourcePointer<SpectralWindow::Cache> windowCache;
+        std::shared_ptr<const SpectralWindow> window;
+        std::vector<Channel> channels;
+        const std::vector<SpectralBand>* bands = nullptr;
+        int numBands = 0;
+    };
+}
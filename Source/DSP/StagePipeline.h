@@ -0,0 +1,125 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "BlockRamp.h"
+
+namespace zl
+{
+    /*  One step of the per-block processing: a filter, a shaper, a mix or
+        the output stage. A pipeline calls it once per sub-block, in order
+        with the other stages, so it must carry its state across calls;
+        `offset` is the sub-block's first sample within the host block, for
+        stages that follow per-block ramps.
+    */
+    template <typename SampleType>
+    class ProcessingStage
+    {
+    public:
+        virtual ~ProcessingStage() = default;
+
+        virtual void process(juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept = 0;
+    };
+
+    /*  A shaper as a stage: shapes every channel of a block in place and
+        mixes the result with its own input by `dryWet`. OversampledShaper
+        calls shape() at the oversampled rate; `firstChannel` is the index of
+        the state that goes with the block's first channel.
+
+        Run by a pipeline directly, it follows the ramps given to
+        setRamps() for the current block.
+    */
+    template <typename SampleType>
+    class ShapingStage : public ProcessingStage<SampleType>
+    {
+    public:
+        using Ramp = BlockRamp<SampleType>;
+
+        virtual void shape(juce::dsp::AudioBlock<SampleType>& block, int firstChannel,
+                           Ramp amount, Ramp dryWet) noexcept = 0;
+
+        void setRamps(Ramp newAmount, Ramp newDryWet) noexcept
+        {
+            stageAmount = newAmount;
+            stageDryWet = newDryWet;
+        }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int offset) noexcept override
+        {
+            shape(block, 0, stageAmount.skipped(offset), stageDryWet.skipped(offset));
+        }
+
+    private:
+        Ramp stageAmount = Ramp::constant(0), stageDryWet = Ramp::constant(1);
+    };
+
+    /*  Told when each stage of a pipeline starts and finishes, with the tag
+        it was added under; e.g. to time the stages.
+    */
+    class StageObserver
+    {
+    public:
+        virtual ~StageObserver() = default;
+
+        virtual void stageStarted(int tag) noexcept = 0;
+        virtual void stageFinished(int tag) noexcept = 0;
+    };
+
+    /*  Runs its stages over a block in sub-blocks small enough that the
+        samples stay in L1 from the first stage to the last, instead of
+        each stage streaming the whole block through the cache on its own.
+        At 64 samples, two channels of doubles and a stage's scratch fit
+        with room to spare.
+
+        Stages are held by reference and never owned; adding them doesn't
+        allocate, so a pipeline can be put together on the audio thread
+        every block.
+    */
+    template <typename SampleType, int maxStages>
+    class StagePipeline
+    {
+    public:
+        static constexpr int defaultSubBlockSize = 64;
+
+        // `tag` is only handed to the observer
+        void add(ProcessingStage<SampleType>& stage, int tag = 0) noexcept
+        {
+            jassert(numStages < maxStages);
+
+            if (numStages < maxStages)
+            {
+                stages[(size_t)numStages] = &stage;
+                tags[(size_t)numStages++] = tag;
+            }
+        }
+
+        int getNumStages() const noexcept { return numStages; }
+
+        void process(juce::dsp::AudioBlock<SampleType>& block, int subBlockSize = defaultSubBlockSize,
+                     StageObserver* observer = nullptr) noexcept
+        {
+            const auto numSamples = block.getNumSamples();
+            const auto step = (size_t)juce::jmax(1, subBlockSize);
+
+            for (size_t start = 0; start < numSamples; start += step)
+            {
+                auto subBlock = block.getSubBlock(start, juce::jmin(step, numSamples - start));
+
+                for (int i = 0; i < numStages; ++i)
+                {
+                    if (observer != nullptr)
+                        observer->stageStarted(tags[(size_t)i]);
+
+                    stages[(size_t)i]->process(subBlock, (int)start);
+
+                    if (observer != nullptr)
+                        observer->stageFinished(tags[(size_t)i]);
+                }
+            }
+        }
+
+    private:
+        std::array<ProcessingStage<SampleType>*, (size_t)maxStages> stages {};
+        std::array<int, (size_t)maxStages> tags {};
+        int numStages = 0;
+    };
+}
@@ -0,0 +1,79 @@
+﻿#include "Instrumentation.h"
+
+#if ZLDISTORT_INSTRUMENTATION
+
+#include <cstdlib>
+#include <new>
+
+#if ZLDISTORT_INSTRUMENTATION_HOOKS && (JUCE_LINUX || JUCE_MAC)
+ #include <dlfcn.h>
+ #include <pthread.h>
+#endif
+
+namespace
+{
+    // plain thread_locals: the hooks below must not allocate or lock themselves
+    thread_local bool onAudioThread = false;
+    thread_local juce::uint32 audioThreadAllocations = 0, audioThreadLocks = 0;
+
+   #if ZLDISTORT_INSTRUMENTATION_HOOKS
+    void* allocate(std::size_t size)
+    {
+        if (onAudioThread)
+            ++audioThreadAllocations;
+
+        if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+   #endif
+}
+
+juce::uint32 zl::instrumentation::getAudioThreadAllocations() noexcept { return audioThreadAllocations; }
+juce::uint32 zl::instrumentation::getAudioThreadLocks() noexcept { return audioThreadLocks; }
+void zl::instrumentation::setAudioThread(bool isAudioThread) noexcept { onAudioThread = isAudioThread; }
+
+#if ZLDISTORT_INSTRUMENTATION_HOOKS
+
+// Only with -fvisibility=hidden (see Instrumentation.h). <new> keeps these at
+// default visibility whatever the flags, so a host that loads plugins
+// RTLD_GLOBAL could still bind to them: profiling builds only, never a release.
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+
+#if JUCE_LINUX || JUCE_MAC
+// Hidden, so it binds only the plugin's own calls (including JUCE's
+// CriticalSection) and is never exported to the host.
+extern "C" __attribute__((visibility("hidden"))) int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    using LockFunction = int (*)(pthread_mutex_t*);
+
+    // no function-local static: its guard would take a lock and recurse
+    static std::atomic<LockFunction> next { nullptr };
+    auto function = next.load(std::memory_order_acquire);
+
+    if (function == nullptr)
+    {
+        function = (LockFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+        next.store(function, std::memory_order_release);
+    }
+
+    if (onAudioThread)
+        ++audioThreadLocks;
+
+    return function(mutex);
+}
+#endif
+
+#endif
+
+#endif
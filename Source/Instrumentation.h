@@ -0,0 +1,327 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "DSP/StagePipeline.h"
+
+// Set to 1 to time every processBlock stage. Costs a few timer reads per
+// block and one extra thread per instance.
+#ifndef ZLDISTORT_INSTRUMENTATION
+ #define ZLDISTORT_INSTRUMENTATION 0
+#endif
+
+// Set to 1 as well to count heap allocations and mutex locks on the audio
+// thread. Instrumentation.cpp then replaces the global operator new/delete
+// and interposes pthread_mutex_lock (Linux and macOS only), which would
+// reach into the host process unless the binary keeps its symbols to
+// itself: only enable it in builds compiled with -fvisibility=hidden. Not
+// in the Benchmark, whose AllocationCounter replaces operator new already.
+// Without it, the counts are reported as off.
+#ifndef ZLDISTORT_INSTRUMENTATION_HOOKS
+ #define ZLDISTORT_INSTRUMENTATION_HOOKS 0
+#endif
+
+namespace zl::instrumentation
+{
+    // the tags the processor's pipeline stages are added under
+    enum Stage
+    {
+        FilterBank = 0,
+        Shaper,         // includes oversampling and the mix fused into the shaper kernels
+        Mix,
+        Limiter,
+        numStages
+    };
+}
+
+#if ZLDISTORT_INSTRUMENTATION
+
+namespace zl::instrumentation
+{
+
+    inline const char* getStageName(int stage)
+    {
+        static const char* const names[] = { "bank", "shaper", "mix", "limiter" };
+        return names[stage];
+    }
+
+    // allocations and locks seen so far on the calling thread while it was
+    // marked as the audio thread; defined in Instrumentation.cpp
+    juce::uint32 getAudioThreadAllocations() noexcept;
+    juce::uint32 getAudioThreadLocks() noexcept;
+    void setAudioThread(bool isAudioThread) noexcept;
+
+    // one entry per processBlock call
+    struct BlockRecord
+    {
+        std::array<juce::int64, numStages> stageTicks {};
+        juce::int64 blockTicks = 0, budgetTicks = 0;
+        int numSamples = 0;
+        juce::uint32 allocations = 0, locks = 0;
+
+        bool missedDeadline() const noexcept { return blockTicks > budgetTicks; }
+    };
+
+    /*  Audio-thread side. As the pipeline's observer it adds each stage's
+        time to the current record, and endBlock() pushes that into a
+        single-producer single-consumer ring. If the ring is full the record
+        is dropped and counted, never waited on. Offline blocks are timed
+        but their allocations and locks aren't counted: rendering may
+        allocate, e.g. to build the engines on the first signal.
+    */
+    class Recorder : public StageObserver
+    {
+    public:
+        void prepare(double sampleRate) noexcept
+        {
+            ticksPerSample = (double)juce::Time::getHighResolutionTicksPerSecond() / sampleRate;
+        }
+
+        void beginBlock(int numSamples, bool realtime) noexcept
+        {
+            setAudioThread(realtime);
+            current = {};
+            current.numSamples = numSamples;
+            current.budgetTicks = (juce::int64)(ticksPerSample * numSamples);
+            allocationsAtStart = getAudioThreadAllocations();
+            locksAtStart = getAudioThreadLocks();
+            blockStart = juce::Time::getHighResolutionTicks();
+        }
+
+        void stageStarted(int) noexcept override { stageStart = juce::Time::getHighResolutionTicks(); }
+
+        void stageFinished(int stage) noexcept override
+        {
+            jassert(juce::isPositiveAndBelow(stage, (int)numStages));
+            current.stageTicks[(size_t)stage] += juce::Time::getHighResolutionTicks() - stageStart;
+        }
+
+        void endBlock() noexcept
+        {
+            current.blockTicks = juce::Time::getHighResolutionTicks() - blockStart;
+            current.allocations = getAudioThreadAllocations() - allocationsAtStart;
+            current.locks = getAudioThreadLocks() - locksAtStart;
+            setAudioThread(false);
+
+            // the audio thread allocated or locked during this block
+            jassert(current.allocations == 0 && current.locks == 0);
+
+            const auto scope = fifo.write(1);
+
+            if (scope.blockSize1 > 0)
+                records[(size_t)scope.startIndex1] = current;
+            else
+                numDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // consumer side, call from one thread only
+        int read(BlockRecord* destination, int maxRecords) noexcept
+        {
+            const auto scope = fifo.read(juce::jmin(maxRecords, fifo.getNumReady()));
+
+            for (int i = 0; i < scope.blockSize1; ++i)
+                destination[i] = records[(size_t)(scope.startIndex1 + i)];
+
+            for (int i = 0; i < scope.blockSize2; ++i)
+                destination[scope.blockSize1 + i] = records[(size_t)(scope.startIndex2 + i)];
+
+            return scope.blockSize1 + scope.blockSize2;
+        }
+
+        juce::uint64 getNumDropped() const noexcept { return numDropped.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr int capacity = 1024;
+
+        juce::AbstractFifo fifo { capacity };
+        std::array<BlockRecord, capacity> records;
+        std::atomic<juce::uint64> numDropped { 0 };
+
+        BlockRecord current;
+        juce::int64 blockStart = 0, stageStart = 0;
+        juce::uint32 allocationsAtStart = 0, locksAtStart = 0;
+        double ticksPerSample = 0.0;
+    };
+
+    class ScopedBlock
+    {
+    public:
+        ScopedBlock(Recorder& r, int numSamples, bool realtime) noexcept : recorder(r) { recorder.beginBlock(numSamples, realtime); }
+        ~ScopedBlock() noexcept { recorder.endBlock(); }
+
+    private:
+        Recorder& recorder;
+    };
+
+    /*  Durations in microseconds, in log2 bins: bin 0 holds everything
+        under 1 us, bin i holds [2^(i-1), 2^i) us. Counters are atomic so
+        any thread can read them while the collector writes.
+    */
+    class Histogram
+    {
+    public:
+        static constexpr int numBins = 24;
+
+        void add(double microseconds) noexcept
+        {
+            const auto bin = microseconds < 1.0 ? 0 : juce::jmin(numBins - 1, 1 + (int)std::log2(microseconds));
+            bins[(size_t)bin].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        juce::uint64 getTotal() const noexcept
+        {
+            juce::uint64 total = 0;
+
+            for (const auto& bin : bins)
+                total += bin.load(std::memory_order_relaxed);
+
+            return total;
+        }
+
+        // upper edge of the bin holding the given fraction of all entries
+        double getPercentile(double fraction) const noexcept
+        {
+            const auto target = (juce::uint64)std::ceil(fraction * (double)getTotal());
+            juce::uint64 count = 0;
+
+            for (int bin = 0; bin < numBins; ++bin)
+            {
+                count += bins[(size_t)bin].load(std::memory_order_relaxed);
+
+                if (count >= target && count > 0)
+                    return std::ldexp(1.0, bin);
+            }
+
+            return 0.0;
+        }
+
+    private:
+        std::array<std::atomic<juce::uint64>, numBins> bins {};
+    };
+
+    /*  Drains a Recorder on a background thread. It fills the histograms and
+        totals that the editor reads, and appends every block that missed its
+        deadline, allocated or locked to a CSV file in the temp folder.
+    */
+    class Collector : private juce::Thread
+    {
+    public:
+        explicit Collector(Recorder& r)
+            : juce::Thread("ZLDistort instrumentation"), recorder(r),
+              dumpFile(juce::File::getSpecialLocation(juce::File::tempDirectory)
+                           .getNonexistentChildFile("ZLDistortV2-instrumentation", ".csv"))
+        {
+            startThread(juce::Thread::Priority::low);
+        }
+
+        ~Collector() override
+        {
+            stopThread(1000);
+        }
+
+        const Histogram& getBlockHistogram() const noexcept { return blockTimes; }
+        const Histogram& getStageHistogram(Stage stage) const noexcept { return stageTimes[(size_t)stage]; }
+
+        juce::String getSummary() const
+        {
+            juce::String text;
+            text << "block p50/p99 " << blockTimes.getPercentile(0.5) << "/" << blockTimes.getPercentile(0.99) << " us";
+
+            for (int stage = 0; stage < numStages; ++stage)
+                text << "  " << getStageName(stage) << " p99 " << stageTimes[(size_t)stage].getPercentile(0.99);
+
+            text << "  misses " << (juce::int64)numMisses.load();
+
+            if (ZLDISTORT_INSTRUMENTATION_HOOKS)
+                text << "  allocs " << (juce::int64)numAllocations.load()
+                     << "  locks " << (juce::int64)numLocks.load();
+            else
+                text << "  allocs/locks off";
+
+            text << "  dropped " << (juce::int64)recorder.getNumDropped();
+            return text;
+        }
+
+        juce::File getDumpFile() const { return dumpFile; }
+
+    private:
+        void run() override
+        {
+            juce::FileOutputStream dump(dumpFile);
+
+            if (dump.openedOk())
+            {
+                dump << "time_ms,samples,block_us,budget_us";
+
+                for (int stage = 0; stage < numStages; ++stage)
+                    dump << "," << getStageName(stage) << "_us";
+
+                dump << ",allocations,locks\n";
+            }
+
+            const auto toMicroseconds = 1.0e6 / (double)juce::Time::getHighResolutionTicksPerSecond();
+            std::array<BlockRecord, 256> batch;
+
+            while (! threadShouldExit())
+            {
+                for (int n; (n = recorder.read(batch.data(), (int)batch.size())) > 0;)
+                {
+                    for (int i = 0; i < n; ++i)
+                    {
+                        const auto& record = batch[(size_t)i];
+                        blockTimes.add((double)record.blockTicks * toMicroseconds);
+
+                        for (size_t stage = 0; stage < numStages; ++stage)
+                            if (record.stageTicks[stage] > 0)
+                                stageTimes[stage].add((double)record.stageTicks[stage] * toMicroseconds);
+
+                        numMisses += record.missedDeadline() ? 1 : 0;
+                        numAllocations += record.allocations;
+                        numLocks += record.locks;
+
+                        if (dump.openedOk() && (record.missedDeadline() || record.allocations > 0 || record.locks > 0))
+                        {
+                            dump << (juce::int64)juce::Time::currentTimeMillis() << "," << record.numSamples
+                                 << "," << (double)record.blockTicks * toMicroseconds
+                                 << "," << (double)record.budgetTicks * toMicroseconds;
+
+                            for (auto ticks : record.stageTicks)
+                                dump << "," << (double)ticks * toMicroseconds;
+
+                            dump << "," << (int)record.allocations << "," << (int)record.locks << "\n";
+                        }
+                    }
+                }
+
+                dump.flush();
+                wait(50);
+            }
+        }
+
+        Recorder& recorder;
+        juce::File dumpFile;
+
+        Histogram blockTimes;
+        std::array<Histogram, numStages> stageTimes;
+        std::atomic<juce::uint64> numMisses { 0 }, numAllocations { 0 }, numLocks { 0 };
+    };
+
+    // one-line live summary for the editor
+    class SummaryLabel : public juce::Label, private juce::Timer
+    {
+    public:
+        explicit SummaryLabel(const Collector& c) : collector(c)
+        {
+            setFont(juce::FontOptions(11.0f));
+            setColour(juce::Label::textColourId, juce::Colours::grey);
+            setTooltip(collector.getDumpFile().getFullPathName());
+            startTimerHz(4);
+        }
+
+    private:
+        void timerCallback() override { setText(collector.getSummary(), juce::dontSendNotification); }
+
+        const Collector& collector;
+    };
+}
+
+#endif
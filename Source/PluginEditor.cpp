@@ -3,7 +3,7 @@
 ZLDistortV2AudioProcessorEditor::ZLDistortV2AudioProcessorEditor(ZLDistortV2AudioProcessor& p)
     : AudioProcessorEditor(&p), processorRef(p)
 {
-    setSize(650, 370);
+    setOpaque(true);
 
     //–– Distortion knob ––
     distortionSlider.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
@@ -42,105 +42,160 @@ ZLDistortV2AudioProcessorEditor::ZLDistortV2AudioProcessorEditor(ZLDistortV2Audi
     modeAttach = std::make_unique<ChoiceAttachment>(
         processorRef.parameters, "DISTORTION_MODE", modeBox);
     
-    //Re-layout when mode changes to harmonic
+    //–– Oversampling factor + filter ––
+    oversamplingBox.addItemList(processorRef.parameters.getParameter("OVERSAMPLING")->getAllValueStrings(), 1);
+    oversamplingBox.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(oversamplingBox);
+    oversamplingFilterBox.addItemList(processorRef.parameters.getParameter("OVERSAMPLING_FILTER")->getAllValueStrings(), 1);
+    oversamplingFilterBox.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(oversamplingFilterBox);
+    antialiasingBox.addItemList(processorRef.parameters.getParameter("ANTIALIASING")->getAllValueStrings(), 1);
+    antialiasingBox.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(antialiasingBox);
+    precisionBox.addItemList(processorRef.parameters.getParameter("PRECISION")->getAllValueStrings(), 1);
+    precisionBox.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(precisionBox);
+    oversamplingLabel.setText("Anti-aliasing", juce::dontSendNotification);
+    oversamplingLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(oversamplingLabel);
+
+    oversamplingAttach = std::make_unique<ChoiceAttachment>(
+        processorRef.parameters, "OVERSAMPLING", oversamplingBox);
+    oversamplingFilterAttach = std::make_unique<ChoiceAttachment>(
+        processorRef.parameters, "OVERSAMPLING_FILTER", oversamplingFilterBox);
+    antialiasingAttach = std::make_unique<ChoiceAttachment>(
+        processorRef.parameters, "ANTIALIASING", antialiasingBox);
+    precisionAttach = std::make_unique<ChoiceAttachment>(
+        processorRef.parameters, "PRECISION", precisionBox);
+
+    //Re-layout when mode changes to harmonic; the first time also builds its controls
     modeBox.onChange = [this] { resized(); };
 
-    //–– Harmonic‑mode controls ––
- // Root Note
+    // Soft‑Clip Toggle
+    softClipLabel.setText("Limit", juce::dontSendNotification);
+    softClipLabel.setJustificationType(juce::Justification::centredLeft);
+    addAndMakeVisible(softClipLabel);
+    addAndMakeVisible(softClipToggle);
+    softClipAttachment.reset(new juce::AudioProcessorValueTreeState::ButtonAttachment(
+        processorRef.parameters, "SOFT_CLIP", softClipToggle));
+
+    // Output stage type (limiter / soft clip)
+    outputStageBox.addItemList(processorRef.parameters.getParameter("OUTPUT_STAGE")->getAllValueStrings(), 1);
+    addAndMakeVisible(outputStageBox);
+    outputStageAttachment.reset(new ChoiceAttachment(
+        processorRef.parameters, "OUTPUT_STAGE", outputStageBox));
+
+    // CPU governor
+    addAndMakeVisible(governorToggle);
+    governorAttachment.reset(new juce::AudioProcessorValueTreeState::ButtonAttachment(
+        processorRef.parameters, "GOVERNOR", governorToggle));
+
+    addAndMakeVisible(signalDisplay);
+
+#if ZLDISTORT_INSTRUMENTATION
+    addAndMakeVisible(instrumentationLabel);
+#endif
+
+    // last, so resized() sees every child
+    setSize(650, 490);
+}
+
+
+
+ZLDistortV2AudioProcessorEditor::HarmonicControls::HarmonicControls(ZLDistortV2AudioProcessor& processor,
+                                                                    juce::Component& parent)
+{
+    // Root Note
     rootNoteLabel.setText("Root Note", juce::dontSendNotification);
     rootNoteLabel.setJustificationType(juce::Justification::centredLeft);
-    addAndMakeVisible(rootNoteLabel);
+    parent.addChildComponent(rootNoteLabel);
 
     // build a fixed 12‑note list instead of calling getMidiNoteNames()
     juce::StringArray midiNotes{ "C", "C#", "D", "D#", "E", "F",
                                  "F#", "G", "G#", "A", "A#", "B" };
     rootNoteBox.addItemList(midiNotes, 1);
-    addAndMakeVisible(rootNoteBox);
+    parent.addChildComponent(rootNoteBox);
 
-    rootNoteBox.onChange = [this]
+    rootNoteBox.onChange = [this, &processor]
         {
             // map 1–12 to 0.0–1.0
             auto val = (rootNoteBox.getSelectedId() - 1) / 11.0f;
-            processorRef.parameters.getParameter("ROOT_NOTE")
+            processor.parameters.getParameter("ROOT_NOTE")
                 ->setValueNotifyingHost(val);
         };
 
     // Scale Type
     scaleTypeLabel.setText("Scale", juce::dontSendNotification);
     scaleTypeLabel.setJustificationType(juce::Justification::centredLeft);
-    addAndMakeVisible(scaleTypeLabel);
+    parent.addChildComponent(scaleTypeLabel);
     scaleTypeBox.addItem("Major", 1);
     scaleTypeBox.addItem("Minor", 2);
-    addAndMakeVisible(scaleTypeBox);
-    scaleTypeBox.onChange = [this]
+    parent.addChildComponent(scaleTypeBox);
+    scaleTypeBox.onChange = [this, &processor]
         {
-            processorRef.parameters.getParameter("SCALE_MINOR")
+            processor.parameters.getParameter("SCALE_MINOR")
                 ->setValueNotifyingHost((scaleTypeBox.getSelectedId() - 1));
         };
 
     // Number of Bands
     numBandsLabel.setText("Bands", juce::dontSendNotification);
     numBandsLabel.setJustificationType(juce::Justification::centredLeft);
-    addAndMakeVisible(numBandsLabel);
+    parent.addChildComponent(numBandsLabel);
     numBandsSlider.setSliderStyle(juce::Slider::LinearHorizontal);
     numBandsSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 50, 20);
     numBandsSlider.setRange(1, 20, 1);
-    addAndMakeVisible(numBandsSlider);
-    numBandsAttachment.reset(new Attachment(processorRef.parameters, "NUM_BANDS", numBandsSlider));
+    parent.addChildComponent(numBandsSlider);
+    numBandsAttachment.reset(new Attachment(processor.parameters, "NUM_BANDS", numBandsSlider));
 
     // Q
     qLabel.setText("Q", juce::dontSendNotification);
     qLabel.setJustificationType(juce::Justification::centredLeft);
-    addAndMakeVisible(qLabel);
+    parent.addChildComponent(qLabel);
     qSlider.setSliderStyle(juce::Slider::LinearHorizontal);
     qSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 50, 20);
     qSlider.setRange(0.1, 10.0, 0.01);
-    addAndMakeVisible(qSlider);
-    qAttachment.reset(new Attachment(processorRef.parameters, "BAND_Q", qSlider));
-
-    // Soft‑Clip Toggle
-    softClipLabel.setText("Limit", juce::dontSendNotification);
-    softClipLabel.setJustificationType(juce::Justification::centredLeft);
-    addAndMakeVisible(softClipLabel);
-    addAndMakeVisible(softClipToggle);
-    softClipAttachment.reset(new juce::AudioProcessorValueTreeState::ButtonAttachment(
-        processorRef.parameters, "SOFT_CLIP", softClipToggle));
+    parent.addChildComponent(qSlider);
+    qAttachment.reset(new Attachment(processor.parameters, "BAND_Q", qSlider));
+
+    // Harmonic engine (filter bank / spectral / multirate)
+    harmonicEngineBox.addItemList(processor.parameters.getParameter("HARMONIC_ENGINE")->getAllValueStrings(), 1);
+    harmonicEngineBox.setJustificationType(juce::Justification::centred);
+    parent.addChildComponent(harmonicEngineBox);
+    harmonicEngineAttachment.reset(new ChoiceAttachment(
+        processor.parameters, "HARMONIC_ENGINE", harmonicEngineBox));
 }
 
-
-
 ZLDistortV2AudioProcessorEditor::~ZLDistortV2AudioProcessorEditor() = default;
 
 void ZLDistortV2AudioProcessorEditor::paint(juce::Graphics& g)
 {
-   // 2) set up a linear gradient from top‑left to bottom‑right
-    juce::Colour c1(30, 30, 30), c2(10, 10, 10);
-    g.fillAll(juce::Colour::fromRGB(20, 20, 20));
-    juce::ColourGradient gradient(c1,
-        0.0f, 0.0f,          // start point
-        c2,
-        (float)getWidth(),
-        (float)getHeight(), // end point
-        false);              // not radial
-
-    g.setGradientFill(gradient);
-
-    // 3) fill the entire background with our gradient
-    g.fillRect(getLocalBounds());
-
-    //draw ZL distort label 
-    g.setColour(juce::Colours::white);
-    g.setFont(25.0f);
-    g.drawFittedText("ZL-Distort",
-        getLocalBounds().removeFromTop(25),
-        juce::Justification::centred, 1);
-
+    g.drawImageAt(background, 0, 0);
 }
 
 void ZLDistortV2AudioProcessorEditor::resized()
 {
+    // background: gradient from top-left to bottom-right plus the title;
+    // resized() also runs on mode changes, so only redraw on a new size
+    if (background.getBounds() != getLocalBounds())
+    {
+        background = juce::Image(juce::Image::RGB, juce::jmax(1, getWidth()), juce::jmax(1, getHeight()), false);
+        juce::Graphics g(background);
+        g.setGradientFill(juce::ColourGradient(juce::Colour(30, 30, 30), 0.0f, 0.0f,
+                                               juce::Colour(10, 10, 10), (float)getWidth(), (float)getHeight(),
+                                               false));
+        g.fillAll();
+
+        g.setColour(juce::Colours::white);
+        g.setFont(25.0f);
+        g.drawFittedText("ZL-Distort", getLocalBounds().removeFromTop(25), juce::Justification::centred, 1);
+    }
+
     auto area = getLocalBounds().reduced(20);
 
+#if ZLDISTORT_INSTRUMENTATION
+    instrumentationLabel.setBounds(getLocalBounds().removeFromBottom(18));
+#endif
+
     // --- Title space (just leave it blank here) ---
     area.removeFromTop(40);
 
@@ -160,6 +215,14 @@ void ZLDistortV2AudioProcessorEditor::resized()
         dryWetSlider.getY() - 20,
         knobSize, 20);
 
+    // --- Oversampling / ADAA (between the knobs) ---
+    auto osArea = knobsRow.withSizeKeepingCentre(140, 140);
+    oversamplingLabel.setBounds(osArea.removeFromTop(20));
+    oversamplingBox.setBounds(osArea.removeFromTop(30).reduced(0, 3));
+    oversamplingFilterBox.setBounds(osArea.removeFromTop(30).reduced(0, 3));
+    antialiasingBox.setBounds(osArea.removeFromTop(30).reduced(0, 3));
+    precisionBox.setBounds(osArea.removeFromTop(30).reduced(0, 3));
+
     // --- Mode row ---
     area.removeFromTop(20);
     auto modeRow = area.removeFromTop(50);
@@ -178,22 +241,42 @@ void ZLDistortV2AudioProcessorEditor::resized()
     softClipToggle.setBounds(modeBox.getRight() + 20 + limLabW,
         modeBox.getY(),
         limH, limH);
+    outputStageBox.setBounds(softClipToggle.getRight() + 5,
+        modeBox.getY(),
+        90, limH);
+
+    // --- CPU governor (left of the mode box) ---
+    governorToggle.setBounds(area.getX(), modeBox.getY(), 130, limH);
+
+    // --- Scope and transfer curve along the bottom ---
+    signalDisplay.setBounds(area.removeFromBottom(120));
+    area.removeFromBottom(10);
 
     // --- Harmonic‑mode extras in the bottom leftover area ---
-    bool isH = (processorRef.parameters
-        .getRawParameterValue("DISTORTION_MODE")->load()
-        == (float)ZLDistortV2AudioProcessor::Harmonic);
-
-    rootNoteLabel.setVisible(isH);
-    rootNoteBox.setVisible(isH);
-    scaleTypeLabel.setVisible(isH);
-    scaleTypeBox.setVisible(isH);
-    numBandsLabel.setVisible(isH);
-    numBandsSlider.setVisible(isH);
-    qLabel.setVisible(isH);
-    qSlider.setVisible(isH);
-
-    if (isH)
+    const auto mode = processorRef.parameters.getRawParameterValue("DISTORTION_MODE")->load();
+    bool isH = (mode == (float)ZLDistortV2AudioProcessor::Harmonic);
+
+    // Chebyshev mode takes its harmonics from the scale and the band count
+    bool usesScale = isH || mode == (float)ZLDistortV2AudioProcessor::Chebyshev;
+
+    if (usesScale && harmonicControls == nullptr)
+        harmonicControls = std::make_unique<HarmonicControls>(processorRef, *this);
+
+    if (harmonicControls == nullptr)
+        return;
+
+    auto& c = *harmonicControls;
+    c.rootNoteLabel.setVisible(isH);
+    c.rootNoteBox.setVisible(isH);
+    c.scaleTypeLabel.setVisible(usesScale);
+    c.scaleTypeBox.setVisible(usesScale);
+    c.numBandsLabel.setVisible(usesScale);
+    c.numBandsSlider.setVisible(usesScale);
+    c.qLabel.setVisible(isH);
+    c.qSlider.setVisible(isH);
+    c.harmonicEngineBox.setVisible(isH);
+
+    if (usesScale)
     {
         // everything left in `area` now is the bottom strip
         auto extras = area;
@@ -203,23 +286,24 @@ void ZLDistortV2AudioProcessorEditor::resized()
         int y0 = extras.getY();
 
         // Root Note (left)
-        rootNoteLabel.setBounds(extras.getX(), y0, 80, rowH);
-        rootNoteBox.setBounds(extras.getX(), y0 + rowH, 100, rowH);
-        rootNoteLabel.setJustificationType(juce::Justification::centred);
+        c.rootNoteLabel.setBounds(extras.getX(), y0, 80, rowH);
+        c.rootNoteBox.setBounds(extras.getX(), y0 + rowH, 100, rowH);
+        c.rootNoteLabel.setJustificationType(juce::Justification::centred);
 
         // Scale (right)
        
-        scaleTypeLabel.setBounds(extras.getRight() - 60, y0, 90, rowH);
+        c.scaleTypeLabel.setBounds(extras.getRight() - 60, y0, 90, rowH);
         
-        scaleTypeBox.setBounds(extras.getRight() - 100, y0 + rowH, 95, rowH);
+        c.scaleTypeBox.setBounds(extras.getRight() - 100, y0 + rowH, 95, rowH);
        
 
         // Bands & Q (centered)
         int totalW = 50 + 120 + 20 + 120;
         int cx = getWidth() / 2 - totalW / 2;
-        numBandsLabel.setBounds(cx, y0, 50, rowH);
-        numBandsSlider.setBounds(cx + 50, y0, 120, rowH);
-        qLabel.setBounds(cx + 50 + 120, y0, 20, rowH);
-        qSlider.setBounds(cx + 50 + 120 + 20, y0, 120, rowH);
+        c.numBandsLabel.setBounds(cx, y0, 50, rowH);
+        c.numBandsSlider.setBounds(cx + 50, y0, 120, rowH);
+        c.qLabel.setBounds(cx + 50 + 120, y0, 20, rowH);
+        c.qSlider.setBounds(cx + 50 + 120 + 20, y0, 120, rowH);
+        c.harmonicEngineBox.setBounds(getWidth() / 2 - 60, y0 + rowH + 4, 120, rowH);
     }
 }
\ No newline at end of file
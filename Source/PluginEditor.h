@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "PluginProcessor.h"
+#include "SignalDisplay.h"
 #include <JuceHeader.h>
 
 class ZLDistortV2AudioProcessorEditor : public juce::AudioProcessorEditor
@@ -26,16 +27,48 @@ private:
     std::unique_ptr<SliderAttachment>      distortionAttach, dryWetAttach;
     std::unique_ptr<ChoiceAttachment>      modeAttach;
 
+    juce::ComboBox      oversamplingBox, oversamplingFilterBox, antialiasingBox, precisionBox;
+    juce::Label         oversamplingLabel;
+    std::unique_ptr<ChoiceAttachment>      oversamplingAttach, oversamplingFilterAttach, antialiasingAttach, precisionAttach;
 
-    // harmonic‑mode only controls
-    juce::ComboBox    rootNoteBox, scaleTypeBox;
-    juce::Slider      numBandsSlider, qSlider;
+
+    // output stage, in every mode
     juce::ToggleButton softClipToggle;
-    juce::Label       rootNoteLabel, scaleTypeLabel, numBandsLabel, qLabel, softClipLabel;
+    juce::ComboBox    outputStageBox;
+    juce::Label       softClipLabel;
 
     using Attachment = juce::AudioProcessorValueTreeState::SliderAttachment;
-    std::unique_ptr<Attachment>   numBandsAttachment, qAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> softClipAttachment;
+    std::unique_ptr<ChoiceAttachment> outputStageAttachment;
+
+    // CPU governor on/off; its tier is a read-only parameter hosts can show
+    juce::ToggleButton governorToggle { "CPU Governor" };
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> governorAttachment;
+
+    // harmonic‑mode only controls, built the first time a mode shows them so
+    // opening the editor in any other mode skips their widgets and attachments
+    struct HarmonicControls
+    {
+        HarmonicControls(ZLDistortV2AudioProcessor&, juce::Component& parent);
+
+        juce::ComboBox    rootNoteBox, scaleTypeBox, harmonicEngineBox;
+        juce::Slider      numBandsSlider, qSlider;
+        juce::Label       rootNoteLabel, scaleTypeLabel, numBandsLabel, qLabel;
+
+        std::unique_ptr<Attachment>   numBandsAttachment, qAttachment;
+        std::unique_ptr<ChoiceAttachment> harmonicEngineAttachment;
+    };
+
+    std::unique_ptr<HarmonicControls> harmonicControls;
+
+    SignalDisplay signalDisplay { processorRef };
+
+    // gradient and title, drawn once per size instead of on every repaint
+    juce::Image background;
+
+#if ZLDISTORT_INSTRUMENTATION
+    zl::instrumentation::SummaryLabel instrumentationLabel { processorRef.instrumentationCollector };
+#endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ZLDistortV2AudioProcessorEditor)
 };
@@ -2,6 +2,133 @@
 #include "PluginEditor.h"
 #include <cmath>
 
+// Set to 1 to run the original scalar shapers instead of the SIMD kernels,
+// e.g. to compare the output of both paths.
+#ifndef ZLDISTORT_SCALAR_SHAPERS
+ #define ZLDISTORT_SCALAR_SHAPERS 0
+#endif
+
+namespace
+{
+    template <typename SampleType>
+    using Kernel = typename zl::ShaperKernels<SampleType>::Kernel;
+
+    template <typename Shape, typename SampleType>
+    Kernel<SampleType> selectKernel()
+    {
+       #if ZLDISTORT_SCALAR_SHAPERS
+        return zl::ShaperKernels<SampleType>::template processReference<Shape>;
+       #else
+        return zl::ShaperKernels<SampleType>::template process<Shape>;
+       #endif
+    }
+
+    template <typename SampleType>
+    Kernel<SampleType> selectExponentialKernel(zl::MathPrecision precision)
+    {
+        switch (precision)
+        {
+        case zl::MathPrecision::High: return selectKernel<zl::ExponentialShape<SampleType, zl::MathPrecision::High>, SampleType>();
+        case zl::MathPrecision::Eco:  return selectKernel<zl::ExponentialShape<SampleType, zl::MathPrecision::Eco>, SampleType>();
+        default:                      return selectKernel<zl::ExponentialShape<SampleType>, SampleType>();
+        }
+    }
+
+    // AntiderivativeShaper::Function for a mode, or -1 if it has no ADAA variant
+    int getAntiderivativeFunction(int distortionMode)
+    {
+        using Type = ZLDistortV2AudioProcessor::DistortionType;
+        using Shaper = zl::AntiderivativeShaper<float>;
+
+        switch (distortionMode)
+        {
+        case Type::HardClip:    return Shaper::HardClip;
+        case Type::Foldback:    return Shaper::Foldback;
+        case Type::Exponential: return Shaper::Exponential;
+        case Type::Wavefold:    return Shaper::Wavefold;
+        default:                return -1;
+        }
+    }
+
+    template <typename SampleType>
+    Kernel<SampleType> getShaperKernel(int distortionMode, zl::MathPrecision precision)
+    {
+        using Type = ZLDistortV2AudioProcessor::DistortionType;
+
+        switch (distortionMode)
+        {
+        case Type::HardClip:    return selectKernel<zl::HardClipShape<SampleType>, SampleType>();
+        case Type::Foldback:    return selectKernel<zl::FoldbackShape<SampleType>, SampleType>();
+        case Type::Exponential: return selectExponentialKernel<SampleType>(precision);
+        case Type::BitCrush:    return selectKernel<zl::BitCrushShape<SampleType>, SampleType>();
+        case Type::Wavefold:    return selectKernel<zl::WavefoldShape<SampleType>, SampleType>();
+        default:                return nullptr;
+        }
+    }
+
+    // below -160 dB; nothing the shapers do to this can be heard
+    template <typename SampleType>
+    constexpr SampleType silenceThreshold = SampleType(1.0e-8);
+
+    // getMagnitude() runs FloatVectorOperations::findMinAndMax, so this is
+    // one vectorised pass that stops at the first channel carrying signal
+    template <typename SampleType>
+    bool isSilent(const juce::AudioBuffer<SampleType>& buffer, int numChannels)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            if (buffer.getMagnitude(ch, 0, buffer.getNumSamples()) > silenceThreshold<SampleType>)
+                return false;
+
+        return true;
+    }
+
+    // a value the plugin reports rather than one the user sets: hosts don't
+    // offer it for automation, and the processor overwrites any other write
+    class ReadOnlyChoice : public juce::AudioParameterChoice
+    {
+    public:
+        using AudioParameterChoice::AudioParameterChoice;
+
+        bool isAutomatable() const override { return false; }
+    };
+
+    // factory programs: a name plus the parameters that differ from their defaults
+    struct FactoryProgram
+    {
+        juce::String name;
+        std::vector<std::pair<juce::String, float>> values;
+    };
+
+    const std::vector<FactoryProgram>& getFactoryPrograms()
+    {
+        using Type = ZLDistortV2AudioProcessor::DistortionType;
+
+        static const std::vector<FactoryProgram> programs
+        {
+            { "Init", {} },
+            { "Warm Drive", { { "DISTORTION", 3.0f }, { "DRYWET", 0.7f },
+                              { "DISTORTION_MODE", (float)Type::Exponential }, { "OUTPUT_STAGE", 1.0f } } },
+            { "Fold Lead", { { "DISTORTION", 6.5f }, { "DRYWET", 0.8f },
+                             { "DISTORTION_MODE", (float)Type::Foldback }, { "OVERSAMPLING", 2.0f } } },
+            { "Crushed", { { "DISTORTION", 7.0f }, { "DRYWET", 0.6f },
+                           { "DISTORTION_MODE", (float)Type::BitCrush } } },
+            { "Wavefolder", { { "DISTORTION", 5.0f }, { "DRYWET", 1.0f },
+                              { "DISTORTION_MODE", (float)Type::Wavefold }, { "ANTIALIASING", 2.0f } } },
+            { "Harmonic Minor Choir", { { "DISTORTION", 4.0f }, { "DRYWET", 0.6f },
+                                        { "DISTORTION_MODE", (float)Type::Harmonic }, { "ROOT_NOTE", 9.0f },
+                                        { "SCALE_MINOR", 1.0f }, { "NUM_BANDS", 14.0f }, { "BAND_Q", 4.0f } } },
+            { "Harmonic Major Shimmer", { { "DISTORTION", 6.0f }, { "DRYWET", 0.45f },
+                                          { "DISTORTION_MODE", (float)Type::Harmonic }, { "ROOT_NOTE", 7.0f },
+                                          { "NUM_BANDS", 20.0f }, { "BAND_Q", 8.0f } } },
+            { "Hard Clip Master", { { "DISTORTION", 1.5f }, { "DRYWET", 1.0f },
+                                    { "DISTORTION_MODE", (float)Type::HardClip }, { "OVERSAMPLING", 3.0f },
+                                    { "OVERSAMPLING_FILTER", 1.0f } } }
+        };
+
+        return programs;
+    }
+}
+
 //==============================================================================
 ZLDistortV2AudioProcessor::ZLDistortV2AudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -16,151 +143,712 @@ ZLDistortV2AudioProcessor::ZLDistortV2AudioProcessor()
 #endif
     parameters(*this, nullptr, "PARAMETERS", createParameterLayout())
 {
+    distortionParam = parameters.getRawParameterValue("DISTORTION");
+    dryWetParam = parameters.getRawParameterValue("DRYWET");
+    modeParam = parameters.getRawParameterValue("DISTORTION_MODE");
     rootNoteParam = parameters.getRawParameterValue("ROOT_NOTE");
     scaleMinorParam = parameters.getRawParameterValue("SCALE_MINOR");
     numBandsParam = parameters.getRawParameterValue("NUM_BANDS");
     bandQParam = parameters.getRawParameterValue("BAND_Q");
     softClipParam = parameters.getRawParameterValue("SOFT_CLIP");
+    outputStageParam = parameters.getRawParameterValue("OUTPUT_STAGE");
+    oversamplingParam = parameters.getRawParameterValue("OVERSAMPLING");
+    oversamplingFilterParam = parameters.getRawParameterValue("OVERSAMPLING_FILTER");
+    antialiasingParam = parameters.getRawParameterValue("ANTIALIASING");
+    precisionParam = parameters.getRawParameterValue("PRECISION");
+    harmonicEngineParam = parameters.getRawParameterValue("HARMONIC_ENGINE");
+    governorParam = parameters.getRawParameterValue("GOVERNOR");
+    qualityTierParam = parameters.getRawParameterValue("QUALITY_TIER");
+
+    // last: the builder reads the parameters from the background thread
+    configurationBuilder.start();
 }
 
-ZLDistortV2AudioProcessor::~ZLDistortV2AudioProcessor() {}
+ZLDistortV2AudioProcessor::~ZLDistortV2AudioProcessor()
+{
+    if (usingOfflineScheduler)
+        offlineScheduler->removeUser();
+}
+
+//==============================================================================
+ZLDistortV2AudioProcessor::ConfigurationBuilder::ConfigurationBuilder(ZLDistortV2AudioProcessor& p)
+    : processor(p)
+{
+}
+
+void ZLDistortV2AudioProcessor::ConfigurationBuilder::start()
+{
+    started = true;
+    thread->addTimeSliceClient(this);
+}
+
+ZLDistortV2AudioProcessor::ConfigurationBuilder::~ConfigurationBuilder()
+{
+    // waits for a running useTimeSlice() to finish
+    thread->removeTimeSliceClient(this);
+}
+
+int ZLDistortV2AudioProcessor::ConfigurationBuilder::useTimeSlice()
+{
+    if (! started)
+        return 20;
+
+    processor.harmonicConfigurations.collectGarbage();
+
+    if (processor.preparationPending.exchange(false))
+        processor.finishPreparation();
+
+    const auto sampleRate = processor.preparedSampleRate.load(std::memory_order_acquire);
+    const auto snapshot = processor.readParameters();
+    const auto& settings = snapshot.bands;
+
+    // parameter changes may come from any thread; this keeps them off the audio thread
+    if ((int)processor.qualityTierParam->load() != snapshot.qualityTier)
+        if (auto* tierParameter = processor.parameters.getParameter("QUALITY_TIER"))
+            tierParameter->setValueNotifyingHost(tierParameter->convertTo0to1((float)snapshot.qualityTier));
+
+    if (sampleRate > 0.0 && (sampleRate != lastSampleRate || settings != lastSettings))
+    {
+        auto configuration = zl::HarmonicConfiguration::build(*processor.harmonicTables, sampleRate, settings);
+        processor.harmonicConfigurations.publish(std::move(configuration));
+        lastSampleRate = sampleRate;
+        lastSettings = settings;
+    }
+
+    return 20;
+}
 
 //==============================================================================
 const juce::String ZLDistortV2AudioProcessor::getName() const { return JucePlugin_Name; }
 bool ZLDistortV2AudioProcessor::acceptsMidi() const { return JucePlugin_WantsMidiInput; }
 bool ZLDistortV2AudioProcessor::producesMidi() const { return JucePlugin_ProducesMidiOutput; }
 bool ZLDistortV2AudioProcessor::isMidiEffect() const { return JucePlugin_IsMidiEffect; }
-double ZLDistortV2AudioProcessor::getTailLengthSeconds() const { return 0.0; }
-int ZLDistortV2AudioProcessor::getNumPrograms() { return 1; }
-int ZLDistortV2AudioProcessor::getCurrentProgram() { return 0; }
-void ZLDistortV2AudioProcessor::setCurrentProgram(int) {}
-const juce::String ZLDistortV2AudioProcessor::getProgramName(int) { return {}; }
+double ZLDistortV2AudioProcessor::getTailLengthSeconds() const { return calculateTailLength(readParameters()); }
+int ZLDistortV2AudioProcessor::getNumPrograms() { return (int)getFactoryPrograms().size(); }
+int ZLDistortV2AudioProcessor::getCurrentProgram() { return currentProgram.load(); }
+
+void ZLDistortV2AudioProcessor::setCurrentProgram(int index)
+{
+    const auto& programs = getFactoryPrograms();
+    if (! juce::isPositiveAndBelow(index, (int)programs.size()))
+        return;
+
+    currentProgram = index;
+
+    // only parameters change here; the DSP follows through the usual
+    // snapshot and the background-built band configuration. Programs set the
+    // sound, so the governor and the tier it reports are left alone
+    for (auto* parameter : getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            if (ranged->isAutomatable() && ranged->paramID != "GOVERNOR")
+                ranged->setValueNotifyingHost(ranged->getDefaultValue());
+
+    for (const auto& [id, value] : programs[(size_t)index].values)
+        if (auto* parameter = parameters.getParameter(id))
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+const juce::String ZLDistortV2AudioProcessor::getProgramName(int index)
+{
+    const auto& programs = getFactoryPrograms();
+    return juce::isPositiveAndBelow(index, (int)programs.size()) ? programs[(size_t)index].name : juce::String();
+}
+
 void ZLDistortV2AudioProcessor::changeProgramName(int, const juce::String&) {}
 
 //==============================================================================
 void ZLDistortV2AudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    std::vector<float> freqs = {
-        155.56f, 174.61f, 207.65f, 233.08f, 277.18f,
-        311.13f, 349.23f, 415.30f, 466.16f, 554.37f,
-        622.25f, 698.46f, 830.61f, 932.33f, 1108.73f,
-        1244.51f, 1396.91f, 1661.22f, 1864.66f, 2217.46f
-    };
+    const juce::ScopedLock lock(preparationLock);
+    preparationPending = false;
 
-    filters.clear();
+    // every instance starts at full quality
+    governor.prepare(sampleRate);
 
-    juce::dsp::ProcessSpec spec{
-        sampleRate,
-        static_cast<juce::uint32> (samplesPerBlock),
-        static_cast<juce::uint32> (getTotalNumInputChannels())
-    };
+    if (isUsingDoublePrecision())
+        prepareChain(doubleChain, sampleRate, samplesPerBlock);
+    else
+        prepareChain(floatChain, sampleRate, samplesPerBlock);
+
+    scope.prepare(sampleRate);
+
+#if ZLDISTORT_INSTRUMENTATION
+    instrumentation.prepare(sampleRate);
+#endif
+
+    preparedSampleRate.store(sampleRate, std::memory_order_release);
+}
+
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::prepareChain(DSPChain<SampleType>& chain, double sampleRate, int samplesPerBlock)
+{
+    chain.spec = { sampleRate, (juce::uint32)samplesPerBlock, (juce::uint32)getTotalNumInputChannels() };
+
+    for (auto& bank : chain.harmonicBanks)
+        bank.prepare(getTotalNumInputChannels(), maxHarmonicBands);
+
+    prepareParallelScratch(chain);
+
+    const auto params = readParameters();
+
+    // the audio thread is stopped, so build the first configuration in place
+    harmonicConfigurations.reset(zl::HarmonicConfiguration::build(*harmonicTables, sampleRate, params.bands));
+    harmonicConfigurations.getCurrent()->applyTo(chain.harmonicBanks[0]);
+    chain.activeHarmonicBank = 0;
+    chain.harmonicFade.prepare(sampleRate);
+
+    // the FFT and multirate engines and the oversampling filters are sized by
+    // the sample rate and cost most of the preparation, which a template full
+    // of instances pays for at load time: none of them is built here. The
+    // first block with signal in it asks for the ones the settings select
+    // (see finishPreparation); until then the filter bank and 1x stand in,
+    // and the latency changes once they are up
+    chain.spectralReady = false;
+    chain.spectralActive = false;
+    chain.multirateReady = false;
+    chain.multirateActive = false;
+
+    selectHarmonicEngine(chain, params);
+
+    chain.silentSamples = 0;
+    chain.idle = false;
+
+    chain.distortionSmoother.reset((SampleType)params.distortion);
+    chain.dryWetSmoother.reset((SampleType)params.dryWet);
+
+    chain.scratch.prepare(numScratchSlots, getTotalNumInputChannels(), samplesPerBlock);
+
+    chain.oversampledShaper.prepare(chain.spec, 0, params.oversamplingFilter);
+    updateOversampling(chain, params);
 
-    for (auto freq : freqs)
+    // one set of shaper state per oversampling configuration, so they can crossfade
+    const auto numShaperChannels = zl::OversampledShaper<SampleType>::numChannelSets * getTotalNumInputChannels();
+    chain.antiderivativeShaper.prepare(numShaperChannels);
+    chain.chebyshevShaper.prepare(sampleRate, numShaperChannels);
+
+    chain.outputStage.prepare({ sampleRate, (juce::uint32)samplesPerBlock, (juce::uint32)getTotalNumOutputChannels() });
+}
+
+// the partial sums of the parallel bank path, about a megabyte per bank, are
+// only held while this instance renders offline
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::prepareParallelScratch(DSPChain<SampleType>& chain)
+{
+    for (auto& bank : chain.harmonicBanks)
     {
-        filters.push_back({
-            juce::dsp::IIR::Coefficients<float>::makeBandPass(sampleRate, freq, 2.0f)
-            });
-        filters.back().prepare(spec);
+        if (usingOfflineScheduler)
+            bank.prepareParallel((int)chain.spec.maximumBlockSize);
+        else
+            bank.releaseParallel();
     }
-    softLimiter.reset();
-    softLimiter.prepare({ sampleRate, (juce::uint32)samplesPerBlock, (juce::uint32)getTotalNumInputChannels() });
+}
 
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::prepareSpectral(DSPChain<SampleType>& chain)
+{
+    chain.spectralBank.prepare(chain.spec.sampleRate, (int)chain.spec.numChannels);
+    chain.spectralReady.store(true, std::memory_order_release);
 }
 
-void ZLDistortV2AudioProcessor::releaseResources() {}
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::prepareMultirate(DSPChain<SampleType>& chain)
+{
+    for (auto& bank : chain.multirateBanks)
+        bank.prepare(chain.spec.sampleRate, (int)chain.spec.numChannels, maxHarmonicBands, (int)chain.spec.maximumBlockSize);
+
+    chain.multirateDryDelay.prepare(chain.spec, chain.multirateBanks[0].getLatencyInSamples());
+    chain.multirateReady.store(true, std::memory_order_release);
+}
+
+void ZLDistortV2AudioProcessor::finishPreparation()
+{
+    const juce::ScopedLock lock(preparationLock);
+
+    if (isUsingDoublePrecision())
+        finishChainPreparation(doubleChain);
+    else
+        finishChainPreparation(floatChain);
+}
+
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::finishChainPreparation(DSPChain<SampleType>& chain)
+{
+    if (chain.spec.sampleRate <= 0.0)
+        return;
+
+    // the audio thread leaves each part alone until its flag is set
+    const auto params = readParameters();
+
+    if (params.harmonicEngine == SpectralEngine && ! chain.spectralReady.load(std::memory_order_acquire))
+        prepareSpectral(chain);
+    else if (params.harmonicEngine == MultirateEngine && ! chain.multirateReady.load(std::memory_order_acquire))
+        prepareMultirate(chain);
+
+    chain.oversampledShaper.prepareConfiguration(getOversamplingIndex(params), params.oversamplingFilter);
+}
+
+template <typename SampleType>
+bool ZLDistortV2AudioProcessor::needsPreparation(const DSPChain<SampleType>& chain, const ParameterSnapshot& params) const noexcept
+{
+    if (params.harmonicEngine == SpectralEngine && ! chain.spectralReady.load(std::memory_order_acquire))
+        return true;
+
+    if (params.harmonicEngine == MultirateEngine && ! chain.multirateReady.load(std::memory_order_acquire))
+        return true;
+
+    return ! chain.oversampledShaper.isAvailable(getOversamplingIndex(params), params.oversamplingFilter);
+}
+
+void ZLDistortV2AudioProcessor::releaseResources()
+{
+    floatChain.scratch.release();
+    doubleChain.scratch.release();
+}
 
 bool ZLDistortV2AudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
-    // only allow mono or stereo, and require input == output
+    // any layout the host offers (stereo, 7.1.4, ambisonics, discrete ...) as
+    // long as input == output; every stage is sized from the channel count
+    // in prepareToPlay
     const auto& outSet = layouts.getMainOutputChannelSet();
     const auto& inSet = layouts.getMainInputChannelSet();
 
-    if ((outSet == juce::AudioChannelSet::mono() ||
-        outSet == juce::AudioChannelSet::stereo())
-        && inSet == outSet)
-    {
-        return true;
-    }
-
-    return false;
+    return inSet == outSet
+        && ! outSet.isDisabled()
+        && outSet.size() <= maxChannels;
 }
 
 
 void ZLDistortV2AudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
+{
+    processSamples(floatChain, buffer);
+}
+
+void ZLDistortV2AudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer&)
+{
+    processSamples(doubleChain, buffer);
+}
+
+// float and double run the same templated DSP, so 64-bit hosts need no conversion
+bool ZLDistortV2AudioProcessor::supportsDoublePrecisionProcessing() const { return true; }
+
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::processSamples(DSPChain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
+#if ZLDISTORT_INSTRUMENTATION
+    const zl::instrumentation::ScopedBlock instrumentedBlock(instrumentation, buffer.getNumSamples(), ! isNonRealtime());
+#endif
+
+    // offline renders have no deadline and always run at full quality
+    const auto governed = governorParam->load() > 0.5f && ! isNonRealtime();
+    if (! governed)
+        governor.reset();
+
+    const zl::QualityGovernor::ScopedMeasurement governorMeasurement(governor, buffer.getNumSamples(), governed);
+
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    float dryWet = parameters.getRawParameterValue("DRYWET")->load();
-    float distortionAmount = parameters.getRawParameterValue("DISTORTION")->load();
-    if (distortionAmount < 0.01f) distortionAmount = 0.02f;
+    if (totalNumInputChannels > 0)
+        scope.pushInput(buffer.getReadPointer(0), buffer.getNumSamples());
 
-    int distortionMode = int(parameters.getRawParameterValue("DISTORTION_MODE")->load());
+    // one atomic read per parameter per block; the kernels only see plain ramps
+    const auto params = readParameters();
+    const auto numSamples = buffer.getNumSamples();
+    const auto distortionRamp = chain.distortionSmoother.getNextRamp((SampleType)params.distortion, numSamples);
+    const auto dryWetRamp = chain.dryWetSmoother.getNextRamp((SampleType)params.dryWet, numSamples);
+    const auto silent = isSilent(buffer, totalNumInputChannels);
 
-    if (distortionMode == DistortionType::Harmonic)
+    // a new engine or oversampling configuration is built off the audio
+    // thread; the current one keeps running meanwhile. Nothing is built
+    // while the input is silent, so instances that never see signal never
+    // pay for it
+    if (! silent && needsPreparation(chain, params))
     {
-        for (int ch = 0; ch < totalNumInputChannels; ++ch)
-            doHarmonicDistortion(buffer, ch, distortionAmount, dryWet);
-        return;
+        if (isNonRealtime())
+            finishPreparation();
+        else
+            preparationPending = true;
     }
 
-    for (int ch = 0; ch < totalNumInputChannels; ++ch)
+    if (params.mode == DistortionType::Harmonic)
+        updateHarmonicConfiguration(chain);
+    else if (params.mode == DistortionType::Chebyshev)
+        chain.chebyshevShaper.setHarmonics(params.bands.minor, params.bands.numBands);
+
+    selectHarmonicEngine(chain, params);
+    updateOversampling(chain, params);
+
+    for (auto& bank : chain.harmonicBanks)
+        bank.setPrecision(params.precision);
+
+    if (chain.multirateActive)
+        for (auto& bank : chain.multirateBanks)
+            bank.setPrecision(params.precision);
+
+    // once the input has been silent for longer than the tail, the output is
+    // silent too: skip every stage until signal comes back
+    if (silent)
     {
-        auto* data = buffer.getWritePointer(ch);
-        for (int s = 0; s < buffer.getNumSamples(); ++s)
+        const auto tailSamples = (int)std::ceil(calculateTailLength(params) * getSampleRate());
+
+        if (chain.silentSamples >= tailSamples)
         {
-            float dry = data[s];
-            float shaped = dry;
-
-            switch (distortionMode)
-            {
-            case DistortionType::HardClip:
-                shaped = juce::jlimit(-0.5f, 0.5f, dry * distortionAmount);
-                break;
-            case DistortionType::Foldback:
-                if (dry > 0.5f || dry < -0.5f)
-                    shaped = std::abs(std::fmod(dry - 0.5f, 1.0f) - 0.5f);
-                shaped *= distortionAmount;
-                break;
-            case DistortionType::Exponential:
-                shaped = std::copysign(1.0f, dry)
-                    * (1.0f - std::exp(-std::abs(dry * distortionAmount)));
-                break;
-            case DistortionType::BitCrush:
-                shaped = std::round(dry * 8.0f) / 8.0f;
-                break;
-            case DistortionType::Wavefold:
-                if (dry > 0.5f)      shaped = 1.0f - (dry - 0.5f);
-                else if (dry < -0.5f) shaped = -1.0f - (dry + 0.5f);
-                shaped *= distortionAmount;
-                break;
-            default:
-                break;
-            }
-
-            data[s] = dry * (1.0f - dryWet) + shaped * dryWet;
-            
-            if (softClipParam->load() > 0.5f)
-            {
-                juce::dsp::AudioBlock<float> block(buffer);
-                juce::dsp::ProcessContextReplacing<float> ctx(block);
-                softLimiter.process(ctx);
-            }
-     
+            if (! chain.idle)
+                snapToSilence(chain);
+
+            for (int ch = 0; ch < totalNumInputChannels; ++ch)
+                buffer.clear(ch, 0, numSamples);
+
+            if (totalNumInputChannels > 0)
+                scope.pushOutput(buffer.getReadPointer(0), numSamples, getLatencySamples());
+
+            return;
         }
+
+        chain.silentSamples = juce::jmin(chain.silentSamples + numSamples, std::numeric_limits<int>::max() / 2);
+    }
+    else
+    {
+        chain.silentSamples = 0;
+        chain.idle = false;
     }
 
+    // filter or shape, mix and output-stage each 64-sample sub-block while
+    // it is still in L1, rather than streaming the whole block through every stage; this
+    // also splits host blocks larger than announced to fit the scratch arena.
+    // Only Harmonic mode hands work to the offline worker threads; there the
+    // sub-blocks are as large as the arena, so each parallel pass has enough
+    // work to pay for the hand-off
+    juce::dsp::AudioBlock<SampleType> block(buffer);
+    const auto capacity = chain.scratch.getCapacity();
+    jassert(capacity > 0); // processBlock called before prepareToPlay?
+
+    if (capacity == 0)
+        return;
+
+    const auto parallel = runsParallel() && params.mode == DistortionType::Harmonic;
+    const auto subBlockSize = parallel ? capacity : juce::jmin(capacity, Pipeline<SampleType>::defaultSubBlockSize);
+
+    // every stage is a member of the chain; only which of them run, and
+    // with which ramps, is decided per block
+    auto input = block.getSubsetChannelBlock(0, (size_t)totalNumInputChannels);
+    Pipeline<SampleType> pipeline;
+
+    if (params.mode == DistortionType::Harmonic)
+        addHarmonicStages(chain, pipeline, distortionRamp, dryWetRamp);
+    else
+        addShaperStage(chain, pipeline, params, distortionRamp, dryWetRamp);
+
+    if (params.softClip)
+    {
+        chain.outputStage.setMode(params.outputStage);
+        pipeline.add(chain.outputStage, zl::instrumentation::Limiter);
+    }
+
+#if ZLDISTORT_INSTRUMENTATION
+    pipeline.process(input, subBlockSize, &instrumentation);
+#else
+    pipeline.process(input, subBlockSize);
+#endif
+
+    if (totalNumInputChannels > 0)
+        scope.pushOutput(buffer.getReadPointer(0), numSamples, getLatencySamples());
+}
+
+void ZLDistortV2AudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
+
+#if ZLDISTORT_OFFLINE_MULTITHREADING
+    if (isNonRealtime == usingOfflineScheduler)
+        return;
+
+    if (isNonRealtime)
+        offlineScheduler->addUser(juce::SystemStats::getNumCpus() - 1);
+    else
+        offlineScheduler->removeUser();
+
+    const juce::ScopedLock lock(getCallbackLock());
+    usingOfflineScheduler = isNonRealtime;
+
+    if (floatChain.spec.sampleRate > 0.0)
+        prepareParallelScratch(floatChain);
+
+    if (doubleChain.spec.sampleRate > 0.0)
+        prepareParallelScratch(doubleChain);
+#endif
+}
+
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::addShaperStage(DSPChain<SampleType>& chain,
+    Pipeline<SampleType>& pipeline,
+    const ParameterSnapshot& params,
+    Ramp<SampleType> distortionAmount,
+    Ramp<SampleType> dryWet)
+{
+    zl::ShapingStage<SampleType>* shaper = &chain.chebyshevShaper;
+    const auto function = params.antialiasing != zl::AntiderivativeShaper<SampleType>::Off
+                              ? getAntiderivativeFunction(params.mode) : -1;
+
+    if (params.mode == DistortionType::Chebyshev)
+    {
+        chain.chebyshevShaper.setOversamplingFactor(chain.oversampledShaper.getFactor());
+    }
+    else if (function >= 0)
+    {
+        chain.antiderivativeShaper.setFunction(function, params.antialiasing);
+        shaper = &chain.antiderivativeShaper;
+    }
+    else
+    {
+        // pick the kernel once per block; it shapes and mixes a whole channel at a time
+        chain.kernelShaper.setKernel(getShaperKernel<SampleType>(params.mode, params.precision));
+        shaper = &chain.kernelShaper;
+    }
+
+    // ADAA starts from silence when it is switched back in
+    if (shaper != &chain.antiderivativeShaper)
+        chain.antiderivativeShaper.setFunction(-1, zl::AntiderivativeShaper<SampleType>::Off);
+
+    chain.oversampledShaper.setShaper(*shaper, distortionAmount, dryWet);
+    pipeline.add(chain.oversampledShaper, zl::instrumentation::Shaper);
+}
+
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::selectHarmonicEngine(DSPChain<SampleType>& chain, const ParameterSnapshot& params)
+{
+    // the spectral engine starts from silence whenever it is switched in, with
+    // the current band layout; until it is prepared the filter bank stands in
+    const auto spectral = params.mode == DistortionType::Harmonic && params.harmonicEngine == SpectralEngine
+                       && chain.spectralReady.load(std::memory_order_acquire);
+    if (spectral && ! chain.spectralActive)
+    {
+        chain.spectralBank.reset();
+        harmonicConfigurations.getCurrent()->applyTo(chain.spectralBank);
+    }
+
+    chain.spectralActive = spectral;
+
+    // so does the multirate engine, and its dry delay with it; a running
+    // layout fade is cut short, the idle bank was never loaded
+    const auto multirate = params.mode == DistortionType::Harmonic && params.harmonicEngine == MultirateEngine
+                        && chain.multirateReady.load(std::memory_order_acquire);
+    if (multirate && ! chain.multirateActive)
+    {
+        for (auto& bank : chain.multirateBanks)
+            bank.reset();
+
+        harmonicConfigurations.getCurrent()->applyTo(chain.multirateBanks[(size_t)chain.activeHarmonicBank]);
+        chain.harmonicFade.cancel();
+        chain.multirateDryDelay.reset();
+    }
+
+    chain.multirateActive = multirate;
+}
+
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::updateOversampling(DSPChain<SampleType>& chain, const ParameterSnapshot& params)
+{
+    chain.oversampledShaper.setConfiguration(getOversamplingIndex(params), params.oversamplingFilter);
+
+    // the dry path is delayed by the same amount, so the host only has to
+    // compensate for the oversampling filters, the spectral engine's frames
+    // or the multirate engine's half-band filters; or at 1x, for
+    // second-order ADAA's sample
+    const auto usesAntiderivative = params.antialiasing != zl::AntiderivativeShaper<SampleType>::Off
+                                 && getAntiderivativeFunction(params.mode) >= 0
+                                 && chain.oversampledShaper.getFactor() == 1;
+    const auto shaperLatency = usesAntiderivative
+                                 ? zl::AntiderivativeShaper<SampleType>::getLatencyInSamples(params.antialiasing)
+                                 : chain.oversampledShaper.getLatencyInSamples();
+    const auto latency = chain.spectralActive ? chain.spectralBank.getLatencyInSamples()
+                       : chain.multirateActive ? chain.multirateBanks[0].getLatencyInSamples()
+                                               : shaperLatency;
+
+    if (getLatencySamples() != latency)
+        setLatencySamples(latency);
+}
+
+int ZLDistortV2AudioProcessor::getOversamplingIndex(const ParameterSnapshot& params) noexcept
+{
+    return params.mode == DistortionType::Harmonic ? 0 : params.oversampling;
+}
+
+bool ZLDistortV2AudioProcessor::getTransferCurve(const float* input, float* output, int numSamples) const
+{
+    const auto params = readParameters();
+
+    if (params.mode == DistortionType::Chebyshev)
+    {
+        zl::ChebyshevShaper<float>::shape(zl::ChebyshevShaper<float>::makeCoefficients(params.bands.minor, params.bands.numBands),
+                                          input, output, numSamples,
+                                          Ramp<float>::constant(params.distortion), Ramp<float>::constant(params.dryWet));
+        return true;
+    }
+
+    const auto kernel = getShaperKernel<float>(params.mode, params.precision);
+
+    if (kernel == nullptr)
+        return false;
+
+    kernel(input, output, numSamples, Ramp<float>::constant(params.distortion), Ramp<float>::constant(params.dryWet));
+    return true;
+}
+
+ZLDistortV2AudioProcessor::MemoryReport ZLDistortV2AudioProcessor::getMemoryReport() const
+{
+    const juce::ScopedLock lock(preparationLock);
+
+    MemoryReport report;
+    report.instanceBytes = floatChain.getSizeInBytes() + doubleChain.getSizeInBytes();
+
+    const auto addShared = [&report](const auto& usage)
+    {
+        report.sharedBytes += usage.bytes;
+        report.unsharedBytes += usage.unsharedBytes;
+        report.numSharedTables += usage.numTables;
+    };
+
+    addShared(harmonicTables->getUsage());
+    addShared(juce::SharedResourcePointer<zl::SpectralWindow::Cache>()->getUsage());
+
+    return report;
+}
+
+double ZLDistortV2AudioProcessor::calculateTailLength(const ParameterSnapshot& params) const noexcept
+{
+    const auto sampleRate = preparedSampleRate.load(std::memory_order_acquire);
+    auto tail = 0.0;
+
+    if (params.mode == DistortionType::Harmonic && params.harmonicEngine != SpectralEngine)
+    {
+        // each band is a two-pole resonator whose envelope decays with time
+        // constant Q / (pi * f); the lowest band rings longest. Wait for
+        // -140 dB so the shaper's gain near zero can't lift it back up.
+        const auto lowest = zl::HarmonicScale::getBandFrequency(params.bands.rootNote, params.bands.minor, 0);
+        tail += std::log(1.0e7) * (double)params.bands.q / (juce::MathConstants<double>::pi * lowest);
+
+        // the multirate engine's half-band filters delay it all and ring as long again
+        if (params.harmonicEngine == MultirateEngine && sampleRate > 0.0)
+            tail += 2.0 * getLatencySamples() / sampleRate;
+    }
+    else if (sampleRate > 0.0)
+    {
+        // oversampling filters and spectral frames ring for about twice
+        // their latency; ADAA remembers up to two samples, and the allpass
+        // on its dry path loses two thirds per sample
+        tail += (2.0 * getLatencySamples() + 16.0) / sampleRate;
+
+        // the DC filter's one pole, down to -140 dB
+        if (params.mode == DistortionType::Chebyshev)
+            tail += std::log(1.0e7) / (juce::MathConstants<double>::twoPi * zl::ChebyshevShaper<double>::dcCutoff);
+    }
+
+    // the limiter's output is silent with its input, but its gain needs the
+    // release time to recover before the state can be dropped
+    if (params.softClip && params.outputStage == zl::OutputStage<float>::Limiter)
+        tail += zl::OutputStage<float>::releaseMs * 0.001;
+
+    return tail;
+}
+
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::snapToSilence(DSPChain<SampleType>& chain)
+{
+    // recursive filters never quite reach zero; clear them so idle instances
+    // don't carry denormals or stale envelopes into the next note
+    for (auto& bank : chain.harmonicBanks)
+        bank.reset();
+
+    chain.harmonicFade.cancel();
+
+    if (chain.spectralActive)
+        chain.spectralBank.reset();
+
+    if (chain.multirateActive)
+    {
+        for (auto& bank : chain.multirateBanks)
+            bank.reset();
+
+        chain.multirateDryDelay.reset();
+    }
+
+    chain.oversampledShaper.reset();
+    chain.antiderivativeShaper.reset();
+    chain.chebyshevShaper.reset();
+    chain.outputStage.reset();
+    chain.idle = true;
+}
+
+ZLDistortV2AudioProcessor::ParameterSnapshot ZLDistortV2AudioProcessor::readParameters() const noexcept
+{
+    ParameterSnapshot snapshot;
+
+    snapshot.distortion = distortionParam->load();
+    if (snapshot.distortion < 0.01f) snapshot.distortion = 0.02f;
+
+    snapshot.dryWet = dryWetParam->load();
+    snapshot.mode = int(modeParam->load());
+    snapshot.softClip = softClipParam->load() > 0.5f;
+    snapshot.outputStage = int(outputStageParam->load());
+    snapshot.oversampling = int(oversamplingParam->load());
+    snapshot.oversamplingFilter = int(oversamplingFilterParam->load());
+    snapshot.antialiasing = int(antialiasingParam->load());
+    snapshot.precision = (zl::MathPrecision)juce::jlimit(0, 2, (int)precisionParam->load());
+    snapshot.harmonicEngine = int(harmonicEngineParam->load());
+
+    snapshot.bands.rootNote = juce::jlimit(0, 11, (int)rootNoteParam->load());
+    snapshot.bands.numBands = juce::jlimit(1, maxHarmonicBands, (int)numBandsParam->load());
+    snapshot.bands.minor = scaleMinorParam->load() > 0.5f;
+    snapshot.bands.q = bandQParam->load();
+
+    // the governor's tier caps the cost of the user's settings; never the
+    // oversampling factor, whose latency the host has already compensated
+    if (governorParam->load() > 0.5f && ! isNonRealtime())
+    {
+        snapshot.qualityTier = governor.getTier();
+        const auto limits = zl::QualityGovernor::getLimits(snapshot.qualityTier);
+
+        snapshot.precision = (zl::MathPrecision)juce::jmax((int)snapshot.precision, (int)limits.precision);
+
+        if (snapshot.mode == DistortionType::Harmonic)
+            snapshot.bands.numBands = juce::jmin(snapshot.bands.numBands, limits.maxBands);
+    }
+
+    return snapshot;
 }
 
 //==============================================================================
 bool ZLDistortV2AudioProcessor::hasEditor() const { return true; }
 juce::AudioProcessorEditor* ZLDistortV2AudioProcessor::createEditor() { return new ZLDistortV2AudioProcessorEditor(*this); }
-void ZLDistortV2AudioProcessor::getStateInformation(juce::MemoryBlock&) {}
-void ZLDistortV2AudioProcessor::setStateInformation(const void*, int) {}
+
+void ZLDistortV2AudioProcessor::getStateInformation(juce::MemoryBlock& destData)
+{
+    auto state = parameters.copyState();
+    state.setProperty("program", currentProgram.load(), nullptr);
+
+    if (const auto xml = state.createXml())
+        copyXmlToBinary(*xml, destData);
+}
+
+void ZLDistortV2AudioProcessor::setStateInformation(const void* data, int sizeInBytes)
+{
+    // parameters only: the band configuration is rebuilt on the background
+    // thread, so recalling a session never blocks the message or audio thread
+    const auto xml = getXmlFromBinary(data, sizeInBytes);
+    if (xml == nullptr || ! xml->hasTagName(parameters.state.getType()))
+        return;
+
+    auto state = juce::ValueTree::fromXml(*xml);
+    currentProgram = juce::jlimit(0, getNumPrograms() - 1, (int)state.getProperty("program", 0));
+    state.removeProperty("program", nullptr);
+    parameters.replaceState(state);
+}
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter() { return new ZLDistortV2AudioProcessor(); }
 
@@ -187,7 +875,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout ZLDistortV2AudioProcessor::c
         "DISTORTION_MODE", // ID
         "Distortion Mode", // name
         juce::StringArray{ "Hard Clip", "Foldback", "Exponential",
-                           "Bit Crush", "Wavefold", "Harmonic" },
+                           "Bit Crush", "Wavefold", "Harmonic", "Chebyshev" },
         0));               // default index
 
     // — harmonic‑mode extras —
@@ -224,42 +912,156 @@ juce::AudioProcessorValueTreeState::ParameterLayout ZLDistortV2AudioProcessor::c
         "Soft Clip Limiter",
         true));            // default = on
 
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        "OUTPUT_STAGE",    // ID
+        "Output Stage",    // name
+        juce::StringArray{ "Limiter", "Soft Clip" },
+        0));               // default = limiter
+
+    // — anti-aliasing —
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        "OVERSAMPLING",    // ID
+        "Oversampling",    // name
+        juce::StringArray{ "1x", "2x", "4x", "8x", "16x" },
+        0));               // default = off
+
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        "OVERSAMPLING_FILTER", // ID
+        "Oversampling Filter", // name
+        juce::StringArray{ "IIR", "Linear Phase" },
+        0));               // default = IIR (lower latency)
+
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        "ANTIALIASING",    // ID
+        "Antialiasing",    // name
+        juce::StringArray{ "Off", "ADAA 1st Order", "ADAA 2nd Order" },
+        0));               // default = off
+
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        "PRECISION",       // ID
+        "Precision",       // name
+        juce::StringArray{ "Exact", "High", "Eco" },
+        1));               // default = high (polynomial exp, error < 1e-6)
+
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        "HARMONIC_ENGINE", // ID
+        "Harmonic Engine", // name
+        juce::StringArray{ "Filter Bank", "Spectral", "Multirate" },
+        0));               // default = filter bank (no latency)
+
+    // — CPU governor —
+    params.push_back(std::make_unique<juce::AudioParameterBool>(
+        "GOVERNOR",        // ID
+        "CPU Governor",    // name
+        false));           // default = off
+
+    params.push_back(std::make_unique<ReadOnlyChoice>(
+        "QUALITY_TIER",    // ID
+        "Quality Tier",    // name
+        juce::StringArray{ "Full", "Reduced", "Low", "Minimum" },
+        0));               // set by the governor only
+
     return { params.begin(), params.end() };
 }
 
-void ZLDistortV2AudioProcessor::doHarmonicDistortion(juce::AudioBuffer<float>& buffer,
-    int channel,
-    float distortionAmount,
-    float dryWet)
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::updateHarmonicConfiguration(DSPChain<SampleType>& chain)
 {
-    if (filters.empty()) return;
-    auto numSamples = buffer.getNumSamples();
-    juce::AudioBuffer<float> harmBuf(1, numSamples);
-    harmBuf.clear();
+    // a layout change arriving mid-fade waits for the fade to finish
+    if (chain.harmonicFade.isFading())
+        return;
+
+    auto* next = harmonicConfigurations.takePending();
+    if (next == nullptr)
+        return;
+
+    const auto* current = harmonicConfigurations.getCurrent();
+
+    // built for another sample rate, or nothing audible changed
+    if (next->sampleRate != getSampleRate()
+        || (current != nullptr && current->matches(next->sampleRate, next->settings)))
+    {
+        harmonicConfigurations.retire(next);
+        return;
+    }
+
+    // load the new layout into the idle bank from silence and fade over to it
+    chain.activeHarmonicBank = 1 - chain.activeHarmonicBank;
+    auto& bank = chain.harmonicBanks[(size_t)chain.activeHarmonicBank];
+    bank.reset();
+    next->applyTo(bank);
 
-    for (auto& f : filters)
+    // the other engines are loaded when they are switched in
+    if (chain.multirateActive)
     {
-        juce::AudioBuffer<float> tmp(1, numSamples);
-        tmp.copyFrom(0, 0, buffer, channel, 0, numSamples);
+        auto& multirateBank = chain.multirateBanks[(size_t)chain.activeHarmonicBank];
+        multirateBank.reset();
+        next->applyTo(multirateBank);
+    }
 
-        juce::dsp::AudioBlock<float> block(tmp);
-        juce::dsp::ProcessContextReplacing<float> ctx(block);
-        f.process(ctx);
+    if (chain.spectralActive)
+        next->applyTo(chain.spectralBank);
 
-        for (int i = 0; i < numSamples; ++i)
-        {
-            auto x = tmp.getSample(0, i);
-            auto d = std::copysign(1.0f, x)
-                * (1.0f - std::exp(-std::abs(x * distortionAmount)));
-            harmBuf.addSample(0, i, d);
-        }
+    harmonicConfigurations.install(next);
+    chain.harmonicFade.start();
+}
+
+template <typename SampleType>
+void ZLDistortV2AudioProcessor::addHarmonicStages(DSPChain<SampleType>& chain,
+    Pipeline<SampleType>& pipeline,
+    Ramp<SampleType> distortionAmount,
+    Ramp<SampleType> dryWet)
+{
+    const auto active = (size_t)chain.activeHarmonicBank;
+    const auto numBands = chain.harmonicBanks[active].getNumActiveBands();
+    if (numBands == 0) return;
+
+    // all scratch comes from the arena, so this path never allocates; each
+    // sub-block uses it from the start
+    const auto numChannels = (size_t)getTotalNumInputChannels();
+    const auto capacity = (size_t)chain.scratch.getCapacity();
+    const auto sums = chain.scratch.getBlock(HarmonicSum, numChannels, capacity);
+    auto* scheduler = runsParallel() ? &offlineScheduler.get() : nullptr;
+
+    // band-pass, shape and sum every band in a single pass, at full or
+    // decimated rates; or one FFT pair per hop for all bands
+    zl::HarmonicStage<SampleType>* engine = &chain.harmonicBanks[active];
+    zl::HarmonicStage<SampleType>* previous = &chain.harmonicBanks[1 - active];
+
+    if (chain.spectralActive)
+    {
+        engine = &chain.spectralBank;
+        chain.harmonicFade.cancel();   // overlapping frames already crossfade
+    }
+    else if (chain.multirateActive)
+    {
+        engine = &chain.multirateBanks[active];
+        previous = &chain.multirateBanks[1 - active];
     }
 
-    auto numBands = (float)filters.size();
-    for (int i = 0; i < numSamples; ++i)
+    engine->setBlock(sums, distortionAmount, scheduler);
+    pipeline.add(*engine, zl::instrumentation::FilterBank);
+
+    // a new band layout fades in over the previous one, brought to the
+    // current bank's gain; the previous bank keeps running until it is done
+    if (chain.harmonicFade.isFading())
     {
-        float d = buffer.getSample(channel, i);
-        float h = harmBuf.getSample(0, i) / numBands;
-        buffer.setSample(channel, i, d * (1.0f - dryWet) + h * dryWet);
+        const auto relativeGain = (SampleType)numBands
+                                / (SampleType)juce::jmax(1, chain.harmonicBanks[1 - active].getNumActiveBands());
+
+        chain.harmonicFade.setBlock(sums, distortionAmount, scheduler);
+        chain.harmonicFade.setPrevious(*previous, chain.scratch.getBlock(HarmonicFadeSum, numChannels, capacity),
+                                       relativeGain);
+        pipeline.add(chain.harmonicFade, zl::instrumentation::Mix);
     }
+
+    // the wet signal of the spectral and multirate engines is late; the
+    // spectral engine hands out its dry signal delayed to match, the
+    // multirate one needs a delay line
+    if (chain.multirateActive)
+        pipeline.add(chain.multirateDryDelay, zl::instrumentation::Mix);
+
+    chain.harmonicMix.setBlock(sums, distortionAmount);
+    chain.harmonicMix.setMix(dryWet, SampleType(1) / (SampleType)numBands);
+    pipeline.add(chain.harmonicMix, zl::instrumentation::Mix);
 }
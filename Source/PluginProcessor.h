@@ -2,6 +2,25 @@
 
 #include <JuceHeader.h>
 #include <juce_dsp/juce_dsp.h>
+#include "DSP/ShaperKernels.h"
+#include "DSP/OutputStage.h"
+#include "DSP/ScratchArena.h"
+#include "DSP/StagePipeline.h"
+#include "DSP/HarmonicStage.h"
+#include "DSP/BlockRamp.h"
+#include "DSP/HarmonicFilterBank.h"
+#include "DSP/HarmonicScale.h"
+#include "DSP/HarmonicConfiguration.h"
+#include "DSP/SpectralHarmonicBank.h"
+#include "DSP/MultirateHarmonicBank.h"
+#include "DSP/OversampledShaper.h"
+#include "DSP/AntiderivativeShaper.h"
+#include "DSP/ChebyshevShaper.h"
+#include "Instrumentation.h"
+#include "TaskScheduler.h"
+#include "ConfigurationExchange.h"
+#include "ScopeFifo.h"
+#include "QualityGovernor.h"
 
 class ZLDistortV2AudioProcessor : public juce::AudioProcessor
 {
@@ -16,17 +35,39 @@ public:
         Exponential,
         BitCrush,
         Wavefold,
-        Harmonic
+        Harmonic,
+        Chebyshev
     };
+
+    enum HarmonicEngineType
+    {
+        FilterBankEngine = 0,   // biquad per band, no latency
+        SpectralEngine,         // STFT, cost nearly independent of the band count
+        MultirateEngine         // filter bank with each band at a decimated rate
+    };
+
+    // widest symmetric bus accepted (7th-order ambisonics)
+    static constexpr int maxChannels = 64;
+
+    // cached raw parameter values, resolved once in the constructor
+    std::atomic<float>* distortionParam = nullptr;   // 0–10
+    std::atomic<float>* dryWetParam = nullptr;   // 0–1
+    std::atomic<float>* modeParam = nullptr;   // DistortionType index
+
     // new parameters
     std::atomic<float>* rootNoteParam = nullptr;   // MIDI note number 0–127
     std::atomic<float>* scaleMinorParam = nullptr;   // 0 = major, 1 = minor
     std::atomic<float>* numBandsParam = nullptr;   // e.g. 1–20 bands
     std::atomic<float>* bandQParam = nullptr;   // 0.1–10.0
     std::atomic<float>* softClipParam = nullptr;   // 0 = off, 1 = on
-
-        // soft‑clip processor
-    juce::dsp::Limiter<float> softLimiter;
+    std::atomic<float>* outputStageParam = nullptr;   // 0 = limiter, 1 = soft clip
+    std::atomic<float>* oversamplingParam = nullptr;   // 0 = 1x ... 4 = 16x
+    std::atomic<float>* oversamplingFilterParam = nullptr;   // 0 = IIR, 1 = linear phase
+    std::atomic<float>* antialiasingParam = nullptr;   // 0 = off, 1 = ADAA 1st order, 2 = ADAA 2nd order
+    std::atomic<float>* precisionParam = nullptr;   // zl::MathPrecision: 0 = exact, 1 = high, 2 = eco
+    std::atomic<float>* harmonicEngineParam = nullptr;   // HarmonicEngineType index
+    std::atomic<float>* governorParam = nullptr;   // 0 = off, 1 = on
+    std::atomic<float>* qualityTierParam = nullptr;   // zl::QualityGovernor::Tier, read-only
 
     void prepareToPlay(double, int) override;
     void releaseResources() override;
@@ -36,6 +77,9 @@ public:
 #endif
 
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
+    void setNonRealtime(bool) noexcept override;
 
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -57,13 +101,241 @@ public:
 
     juce::AudioProcessorValueTreeState parameters;
 
+    // decimated input/output pairs for the editor's scope
+    zl::ScopeFifo scope;
+
+    // the static curve of the current mode and settings (shaper and dry/wet,
+    // before the output stage); false in modes without one, i.e. Harmonic
+    bool getTransferCurve(const float* input, float* output, int numSamples) const;
+
+    // heap memory behind the DSP: what this instance owns, and the tables it
+    // shares with every other instance in the process (counted once)
+    struct MemoryReport
+    {
+        size_t instanceBytes = 0;
+        size_t sharedBytes = 0, unsharedBytes = 0;   // unshared: with a copy per user
+        int numSharedTables = 0;
+    };
+
+    // message thread, outside prepareToPlay; JUCE's oversampling filters and FFTs are not counted
+    MemoryReport getMemoryReport() const;
+
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    // builds the engine and oversampling configuration the settings select,
+    // which prepareToPlay leaves to the first block with signal: called on the
+    // background thread when the audio thread asks for it, or by the audio
+    // thread itself while rendering offline
+    void finishPreparation();
+
 private:
-    juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
-    void doHarmonicDistortion(juce::AudioBuffer<float>&, int, float, float);
+    enum ScratchSlot
+    {
+        HarmonicSum = 0,
+        HarmonicFadeSum,
+        numScratchSlots
+    };
+
+    static constexpr int maxHarmonicBands = zl::HarmonicTables::maxBands;
+
+    // plain copy of every parameter, taken once at the start of each block
+    struct ParameterSnapshot
+    {
+        float distortion = 0.0f, dryWet = 0.0f;
+        int mode = 0, outputStage = 0;
+        int oversampling = 0, oversamplingFilter = 0, antialiasing = 0;
+        int harmonicEngine = 0;
+        int qualityTier = zl::QualityGovernor::Full;
+        zl::MathPrecision precision = zl::MathPrecision::Exact;
+        bool softClip = false;
+        zl::HarmonicBandSettings bands;
+    };
+
+    ParameterSnapshot readParameters() const noexcept;
+
+    // how long the output keeps ringing after the input stops, in seconds
+    double calculateTailLength(const ParameterSnapshot&) const noexcept;
+
+    // everything processBlock touches, once per sample type; only the chain
+    // matching the host's processing precision is prepared
+    template <typename SampleType>
+    struct DSPChain
+    {
+        juce::dsp::ProcessSpec spec {};
+        zl::ScratchArena<SampleType> scratch;
+
+        // two banks so a new band layout can crossfade in: the active one
+        // runs the current configuration, the other fades out the previous one
+        std::array<zl::HarmonicFilterBank<SampleType>, 2> harmonicBanks;
+        int activeHarmonicBank = 0;
+        zl::HarmonicCrossfade<SampleType> harmonicFade;
+
+        // the FFT alternative to the banks; runs only while selected
+        zl::SpectralHarmonicBank<SampleType> spectralBank;
+        bool spectralActive = false;
+
+        // the same banks split over decimated rates, faded like harmonicBanks;
+        // the dry signal is delayed by their latency
+        std::array<zl::MultirateHarmonicBank<SampleType>, 2> multirateBanks;
+        zl::DryDelayStage<SampleType> multirateDryDelay;
+        bool multirateActive = false;
+
+        // only the engine the settings select is prepared; another one is
+        // built on the background thread once selected, and the audio thread
+        // keeps to the filter bank until it is ready
+        std::atomic<bool> spectralReady { false }, multirateReady { false };
+
+        // whichever engine runs, its sum is mixed with the dry signal here
+        zl::HarmonicMix<SampleType> harmonicMix;
+
+        zl::BlockSmoother<SampleType> distortionSmoother, dryWetSmoother;
+
+        // only the waveshapers are oversampled, never the harmonic filter bank
+        zl::OversampledShaper<SampleType> oversampledShaper;
+
+        // the memoryless shapers, one kernel per mode
+        zl::KernelShaper<SampleType> kernelShaper;
+
+        // antiderivative anti-aliasing, an alternative to oversampling with a sample of latency at most
+        zl::AntiderivativeShaper<SampleType> antiderivativeShaper;
+
+        // scale-weighted harmonics straight from a polynomial, no filters
+        zl::ChebyshevShaper<SampleType> chebyshevShaper;
+
+        // soft‑clip / limiter output stage
+        zl::OutputStage<SampleType> outputStage;
+
+        // consecutive silent input samples; idle once past the tail
+        int silentSamples = 0;
+        bool idle = false;
+
+        size_t getSizeInBytes() const noexcept
+        {
+            auto bytes = scratch.getSizeInBytes() + spectralBank.getSizeInBytes();
+
+            for (const auto& bank : harmonicBanks)
+                bytes += bank.getSizeInBytes();
 
-    std::vector<juce::dsp::ProcessorDuplicator<
-        juce::dsp::IIR::Filter<float>,
-        juce::dsp::IIR::Coefficients<float>>> filters;
+            for (const auto& bank : multirateBanks)
+                bytes += bank.getSizeInBytes();
+
+            return bytes;
+        }
+    };
+
+    DSPChain<float> floatChain;
+    DSPChain<double> doubleChain;
+
+    template <typename SampleType>
+    using Ramp = zl::BlockRamp<SampleType>;
+
+    // engine, crossfade, dry delay, mix and output stage at most
+    template <typename SampleType>
+    using Pipeline = zl::StagePipeline<SampleType, 5>;
+
+    template <typename SampleType>
+    void prepareChain(DSPChain<SampleType>&, double, int);
+
+    template <typename SampleType>
+    void prepareParallelScratch(DSPChain<SampleType>&);
+
+    template <typename SampleType>
+    void prepareSpectral(DSPChain<SampleType>&);
+
+    template <typename SampleType>
+    void prepareMultirate(DSPChain<SampleType>&);
+
+    template <typename SampleType>
+    void finishChainPreparation(DSPChain<SampleType>&);
+
+    template <typename SampleType>
+    bool needsPreparation(const DSPChain<SampleType>&, const ParameterSnapshot&) const noexcept;
+
+    static int getOversamplingIndex(const ParameterSnapshot&) noexcept;
+
+    template <typename SampleType>
+    void processSamples(DSPChain<SampleType>&, juce::AudioBuffer<SampleType>&);
+
+    template <typename SampleType>
+    void addHarmonicStages(DSPChain<SampleType>&, Pipeline<SampleType>&, Ramp<SampleType>, Ramp<SampleType>);
+
+    template <typename SampleType>
+    void addShaperStage(DSPChain<SampleType>&, Pipeline<SampleType>&, const ParameterSnapshot&,
+                        Ramp<SampleType>, Ramp<SampleType>);
+
+    template <typename SampleType>
+    void updateHarmonicConfiguration(DSPChain<SampleType>&);
+
+    template <typename SampleType>
+    void snapToSilence(DSPChain<SampleType>&);
+
+    template <typename SampleType>
+    void selectHarmonicEngine(DSPChain<SampleType>&, const ParameterSnapshot&);
+
+    template <typename SampleType>
+    void updateOversampling(DSPChain<SampleType>&, const ParameterSnapshot&);
+
+    // worker threads exist only while some instance renders offline; one pool
+    // for the whole process, this instance counts as a user while offline
+    juce::SharedResourcePointer<zl::TaskScheduler> offlineScheduler;
+    bool usingOfflineScheduler = false;   // changes under the callback lock
+
+    bool runsParallel() const noexcept { return usingOfflineScheduler && offlineScheduler->isRunning(); }
+
+    // caps the settings' cost while playing in real time, when GOVERNOR is on;
+    // the background thread mirrors its tier into QUALITY_TIER
+    zl::QualityGovernor governor;
+
+    // band coefficients for every root, scale and Q in use, shared with the
+    // other instances in the process
+    juce::SharedResourcePointer<zl::HarmonicTables::Cache> harmonicTables;
+
+    // band coefficients are built on the shared background thread and
+    // swapped in by the audio thread; prepareToPlay builds them in place
+    zl::ConfigurationExchange<zl::HarmonicConfiguration> harmonicConfigurations;
+
+    // set by the audio thread while the settings select something not built
+    // yet; the lock keeps finishPreparation() out of prepareToPlay
+    std::atomic<bool> preparationPending { false };
+    juce::CriticalSection preparationLock;
+
+    // the rate prepareToPlay last ran at, for threads other than the audio
+    // thread; getSampleRate() is a plain field the host may be writing
+    std::atomic<double> preparedSampleRate { 0.0 };
+
+    // polls the band parameters and the sample rate, publishes a new
+    // configuration when they change and frees the retired ones
+    class ConfigurationBuilder : private juce::TimeSliceClient
+    {
+    public:
+        explicit ConfigurationBuilder(ZLDistortV2AudioProcessor&);
+        ~ConfigurationBuilder() override;
+
+        // the shared thread is already running: call once the processor is
+        // fully constructed, i.e. its parameter pointers are resolved
+        void start();
+
+    private:
+        int useTimeSlice() override;
+
+        ZLDistortV2AudioProcessor& processor;
+        std::atomic<bool> started { false };
+        juce::SharedResourcePointer<zl::BackgroundThread> thread;
+        zl::HarmonicBandSettings lastSettings;
+        double lastSampleRate = 0.0;
+    };
+
+    ConfigurationBuilder configurationBuilder { *this };
+
+    std::atomic<int> currentProgram { 0 };
+
+#if ZLDISTORT_INSTRUMENTATION
+public:
+    // stage timings and audio-thread allocation/lock counts, see Instrumentation.h
+    zl::instrumentation::Recorder instrumentation;
+    zl::instrumentation::Collector instrumentationCollector { instrumentation };
+private:
+#endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ZLDistortV2AudioProcessor)
 };
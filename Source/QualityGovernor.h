@@ -0,0 +1,207 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "DSP/FastMath.h"
+
+namespace zl
+{
+    /*  Opt-in quality governor for real-time playback.
+
+        Two loads are watched, and the higher one decides:
+
+        - this instance's: each block's processing time against the block's
+          own duration (its real-time deadline), averaged over ~0.3 s. It
+          catches one heavy instance on an otherwise idle audio thread.
+        - the session's: the processing time of every governed instance in
+          the process, summed through a shared SessionLoad, per second of
+          wall-clock time and per audio thread the host runs them on (the
+          most instances seen processing at once, at most one per core). One
+          instance of many never gets near its own deadline, but a hundred of
+          them can fill the host's threads; this is the share they use
+          between them.
+
+        Above half (of the deadline, or of those threads), or on any single
+        overrun, the governor steps one tier down; below a fifth for 3 s, one
+        tier back up. After every step it holds for 0.5 s so the new tier's
+        cost shows in the averages before the next decision. With the session
+        load, every governed instance sees the same signal and steps together.
+
+        The tiers only cap the user's settings (see Limits); the processor
+        applies them through its parameter snapshot, so every change takes the
+        same crossfaded path as a change made by hand. None of them touches
+        the oversampling factor: its latency would change mid-playback.
+    */
+    class QualityGovernor
+    {
+    public:
+        enum Tier
+        {
+            Full = 0,
+            Reduced,
+            Low,
+            Minimum,
+            numTiers
+        };
+
+        struct Limits
+        {
+            int maxBands;                // harmonic bands
+            MathPrecision precision;     // shaper approximation, at least this cheap
+        };
+
+        static Limits getLimits(int tier) noexcept
+        {
+            static constexpr Limits limits[] = {
+                { std::numeric_limits<int>::max(), MathPrecision::Exact },
+                { 12, MathPrecision::High },
+                { 8, MathPrecision::Eco },
+                { 4, MathPrecision::Eco }
+            };
+
+            return limits[juce::jlimit(0, numTiers - 1, tier)];
+        }
+
+        static constexpr double stepDownLoad = 0.5, stepUpLoad = 0.2;
+        static constexpr double averagingSeconds = 0.3, holdSeconds = 0.5, recoverySeconds = 3.0;
+
+        // every instance in the process adds its processing time here;
+        // peakProcessing is the most instances processing at once since a
+        // window last closed, in any instance
+        struct SessionLoad
+        {
+            std::atomic<juce::int64> busyTicks { 0 };
+            std::atomic<int> processing { 0 }, peakProcessing { 1 };
+
+            void enter() noexcept
+            {
+                const auto n = processing.fetch_add(1, std::memory_order_relaxed) + 1;
+                auto peak = peakProcessing.load(std::memory_order_relaxed);
+
+                while (n > peak && ! peakProcessing.compare_exchange_weak(peak, n, std::memory_order_relaxed)) {}
+            }
+
+            void leave() noexcept { processing.fetch_sub(1, std::memory_order_relaxed); }
+        };
+
+        void prepare(double newSampleRate) noexcept
+        {
+            sampleRate = newSampleRate;
+            numCores = juce::jmax(1, juce::SystemStats::getNumCpus());
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            load = 0.0;
+            sessionLoad = 0.0;
+            windowStartTicks = 0;
+            secondsSinceStep = holdSeconds;
+            secondsBelow = 0.0;
+            tier.store(Full, std::memory_order_relaxed);
+        }
+
+        // any thread
+        int getTier() const noexcept { return tier.load(std::memory_order_relaxed); }
+
+        // audio thread, once per block: `ticks` spent on `numSamples` samples
+        void update(juce::int64 ticks, int numSamples) noexcept
+        {
+            if (sampleRate <= 0.0 || numSamples <= 0)
+                return;
+
+            const auto seconds = (double)numSamples / sampleRate;
+            const auto blockLoad = juce::Time::highResolutionTicksToSeconds(ticks) / seconds;
+
+            // the same time constant whatever the block size
+            load += seconds / (averagingSeconds + seconds) * (blockLoad - load);
+            updateSessionLoad(ticks);
+
+            const auto decisive = juce::jmax(load, sessionLoad);
+            secondsSinceStep += seconds;
+            secondsBelow = decisive < stepUpLoad ? secondsBelow + seconds : 0.0;
+
+            if (secondsSinceStep < holdSeconds)
+                return;
+
+            const auto current = getTier();
+
+            if ((decisive > stepDownLoad || blockLoad > 1.0) && current < Minimum)
+                step(current + 1);
+            else if (secondsBelow >= recoverySeconds && current > Full)
+                step(current - 1);
+        }
+
+        // times the enclosing scope and passes it to update(), if enabled
+        class ScopedMeasurement
+        {
+        public:
+            ScopedMeasurement(QualityGovernor& g, int n, bool enabled) noexcept
+                : governor(enabled ? &g : nullptr), numSamples(n),
+                  start(enabled ? juce::Time::getHighResolutionTicks() : 0)
+            {
+                if (governor != nullptr)
+                    governor->session->enter();
+            }
+
+            ~ScopedMeasurement() noexcept
+            {
+                if (governor != nullptr)
+                {
+                    governor->update(juce::Time::getHighResolutionTicks() - start, numSamples);
+                    governor->session->leave();
+                }
+            }
+
+        private:
+            QualityGovernor* governor;
+            int numSamples;
+            juce::int64 start;
+        };
+
+    private:
+        // wall-clock windows of averagingSeconds; each instance reads the sum
+        // over its own windows, so no instance has to own the measurement
+        void updateSessionLoad(juce::int64 ticks) noexcept
+        {
+            const auto busy = session->busyTicks.fetch_add(ticks, std::memory_order_relaxed) + ticks;
+            const auto now = juce::Time::getHighResolutionTicks();
+
+            if (windowStartTicks == 0)
+            {
+                windowStartTicks = now;
+                windowStartBusy = busy;
+                return;
+            }
+
+            const auto elapsed = juce::Time::highResolutionTicksToSeconds(now - windowStartTicks);
+
+            if (elapsed < averagingSeconds)
+                return;
+
+            // restart the peak from the instances processing now (this one
+            // included), so it falls again when the session shrinks
+            const auto peak = session->peakProcessing.exchange(session->processing.load(std::memory_order_relaxed),
+                                                               std::memory_order_relaxed);
+            const auto numThreads = juce::jlimit(1, numCores, peak);
+            sessionLoad = juce::Time::highResolutionTicksToSeconds(busy - windowStartBusy) / (elapsed * numThreads);
+            windowStartTicks = now;
+            windowStartBusy = busy;
+        }
+
+        void step(int newTier) noexcept
+        {
+            tier.store(newTier, std::memory_order_relaxed);
+            secondsSinceStep = 0.0;
+            secondsBelow = 0.0;
+        }
+
+        double sampleRate = 0.0, load = 0.0;
+        double secondsSinceStep = holdSeconds, secondsBelow = 0.0;
+        std::atomic<int> tier { Full };
+
+        juce::SharedResourcePointer<SessionLoad> session;
+        double sessionLoad = 0.0;
+        juce::int64 windowStartTicks = 0, windowStartBusy = 0;
+        int numCores = 1;
+    };
+}
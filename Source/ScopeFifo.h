@@ -0,0 +1,119 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+
+namespace zl
+{
+    /*  Decimated input/output pairs of the first channel, from the audio
+        thread to the editor's scope and transfer-curve display.
+
+        The audio thread keeps every decimation-th input sample and pairs it
+        with the output sample it became, however many samples of latency
+        later that is. Pairs go into a single-producer ring that never
+        waits: if the editor falls behind they are dropped. While no display
+        is attached, pushing costs one atomic load.
+    */
+    class ScopeFifo
+    {
+    public:
+        struct Point
+        {
+            float input = 0.0f, output = 0.0f;
+        };
+
+        static constexpr int capacity = 4096;
+        static constexpr double pointsPerSecond = 2000.0;
+
+        // call while the audio thread is stopped
+        void prepare(double sampleRate) noexcept
+        {
+            decimation = juce::jmax(1, juce::roundToInt(sampleRate / pointsPerSecond));
+            time = 0;
+            pendingStart = pendingEnd = 0;
+        }
+
+        // the editor switches recording on while a display is open
+        void setActive(bool shouldBeActive) noexcept { active = shouldBeActive; }
+
+        //==============================================================================
+        // audio thread, before the block is processed
+        template <typename SampleType>
+        void pushInput(const SampleType* input, int numSamples) noexcept
+        {
+            if (! active.load(std::memory_order_relaxed))
+                return;
+
+            for (auto i = (int)((decimation - time % decimation) % decimation); i < numSamples; i += decimation)
+            {
+                if (pendingEnd - pendingStart == pendingCapacity)
+                    break;
+
+                pending[(size_t)(pendingEnd++ % pendingCapacity)] = { time + i, (float)input[i] };
+            }
+        }
+
+        // audio thread, after the block is processed; `latency` is the delay
+        // between an input sample and its output
+        template <typename SampleType>
+        void pushOutput(const SampleType* output, int numSamples, int latency) noexcept
+        {
+            const auto blockEnd = time + numSamples;
+
+            while (pendingStart != pendingEnd)
+            {
+                const auto& sample = pending[(size_t)(pendingStart % pendingCapacity)];
+                const auto outputTime = sample.time + latency;
+
+                if (outputTime >= blockEnd)
+                    break;
+
+                // older than this block: the latency changed, drop it
+                if (outputTime >= time)
+                    write({ sample.value, (float)output[outputTime - time] });
+
+                ++pendingStart;
+            }
+
+            time = blockEnd;
+        }
+
+        //==============================================================================
+        // editor: copies up to maxPoints of the oldest pairs, returns how many
+        int pull(Point* destination, int maxPoints) noexcept
+        {
+            const auto scope = fifo.read(juce::jmin(maxPoints, fifo.getNumReady()));
+            int n = 0;
+            scope.forEach([&](int index) { destination[n++] = points[(size_t)index]; });
+            return n;
+        }
+
+    private:
+        void write(Point point) noexcept
+        {
+            if (fifo.getFreeSpace() == 0)
+                return;
+
+            const auto scope = fifo.write(1);
+            scope.forEach([&](int index) { points[(size_t)index] = point; });
+        }
+
+        struct PendingSample
+        {
+            juce::int64 time;
+            float value;
+        };
+
+        static constexpr int pendingCapacity = 1024;
+
+        std::atomic<bool> active { false };
+        int decimation = 1;
+
+        // audio thread only
+        juce::int64 time = 0;
+        std::array<PendingSample, (size_t)pendingCapacity> pending {};
+        juce::int64 pendingStart = 0, pendingEnd = 0;
+
+        juce::AbstractFifo fifo { capacity };
+        std::array<Point, (size_t)capacity> points {};
+    };
+}
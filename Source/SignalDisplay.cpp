@@ -0,0 +1,194 @@
+﻿#include "SignalDisplay.h"
+
+namespace
+{
+    const juce::Colour panelColour(16, 16, 16);
+    const juce::Colour gridColour(45, 45, 45);
+    const juce::Colour inputColour(110, 110, 110);
+    const juce::Colour outputColour(255, 140, 40);
+
+    // both axes span ±displayRange; louder values are pinned to the edge
+    constexpr float displayRange = 1.5f;
+}
+
+SignalDisplay::SignalDisplay(ZLDistortV2AudioProcessor& p) : processorRef(p)
+{
+    setOpaque(true);
+
+    for (int i = 0; i < curveResolution; ++i)
+        curveInput[(size_t)i] = juce::jmap((float)i, 0.0f, (float)(curveResolution - 1), -displayRange, displayRange);
+
+    processorRef.scope.setActive(true);
+    startTimerHz(30);
+}
+
+SignalDisplay::~SignalDisplay()
+{
+    processorRef.scope.setActive(false);
+}
+
+void SignalDisplay::paint(juce::Graphics& g)
+{
+    g.drawImageAt(background, 0, 0);
+
+    g.setColour(inputColour);
+    g.strokePath(inputPath, juce::PathStrokeType(1.0f));
+    g.setColour(outputColour);
+    g.strokePath(outputPath, juce::PathStrokeType(1.0f));
+
+    g.setColour(juce::Colours::white);
+    g.strokePath(curvePath, juce::PathStrokeType(1.5f));
+    g.setColour(outputColour);
+    g.fillPath(dotPath);
+}
+
+void SignalDisplay::resized()
+{
+    auto bounds = getLocalBounds();
+    curveArea = bounds.removeFromRight(bounds.getHeight());
+    bounds.removeFromRight(10);
+    scopeArea = bounds;
+
+    // everything static is drawn once here instead of on every repaint
+    background = juce::Image(juce::Image::RGB, juce::jmax(1, getWidth()), juce::jmax(1, getHeight()), true);
+    juce::Graphics g(background);
+    g.fillAll(juce::Colour::fromRGB(20, 20, 20));
+
+    for (auto area : { scopeArea, curveArea })
+    {
+        g.setColour(panelColour);
+        g.fillRect(area);
+        g.setColour(gridColour);
+        g.drawRect(area);
+        g.drawHorizontalLine(area.getCentreY(), (float)area.getX(), (float)area.getRight());
+    }
+
+    g.drawVerticalLine(curveArea.getCentreX(), (float)curveArea.getY(), (float)curveArea.getBottom());
+
+    g.setFont(11.0f);
+    g.setColour(inputColour);
+    g.drawText("In", scopeArea.reduced(4).removeFromTop(12), juce::Justification::left);
+    g.setColour(outputColour);
+    g.drawText("Out", scopeArea.reduced(4).removeFromTop(12).withTrimmedLeft(18), juce::Justification::left);
+
+    rebuildScopePaths();
+    rebuildCurvePaths();
+}
+
+void SignalDisplay::timerCallback()
+{
+    // the FIFO still has to be drained while hidden, but nothing is drawn
+    const auto scopeChanged = readScope();
+    const auto curveChanged = updateTransferCurve();
+
+    if (! isShowing())
+        return;
+
+    if (scopeChanged)
+    {
+        rebuildScopePaths();
+        repaint(scopeArea);
+    }
+
+    if (scopeChanged || curveChanged)
+    {
+        rebuildCurvePaths();
+        repaint(curveArea);
+    }
+}
+
+bool SignalDisplay::readScope()
+{
+    const auto numRead = processorRef.scope.pull(incoming.data(), (int)incoming.size());
+
+    for (int i = 0; i < numRead; ++i)
+    {
+        history[(size_t)historyEnd] = incoming[(size_t)i];
+        historyEnd = (historyEnd + 1) % historySize;
+    }
+
+    return numRead > 0;
+}
+
+bool SignalDisplay::updateTransferCurve()
+{
+    const std::array<float, 6> key { processorRef.modeParam->load(), processorRef.distortionParam->load(),
+                                     processorRef.dryWetParam->load(), processorRef.precisionParam->load(),
+                                     processorRef.scaleMinorParam->load(), processorRef.numBandsParam->load() };
+
+    if (curveIsValid && key == curveKey)
+        return false;
+
+    curveKey = key;
+    curveIsValid = true;
+    hasCurve = processorRef.getTransferCurve(curveInput.data(), curveOutput.data(), curveResolution);
+    return true;
+}
+
+void SignalDisplay::rebuildScopePaths()
+{
+    inputPath.clear();
+    outputPath.clear();
+
+    if (scopeArea.isEmpty())
+        return;
+
+    const auto area = scopeArea.toFloat().reduced(1.0f);
+    const auto step = area.getWidth() / (float)(historySize - 1);
+
+    const auto toY = [&area](float value)
+    {
+        return juce::jmap(juce::jlimit(-displayRange, displayRange, value),
+                          displayRange, -displayRange, area.getY(), area.getBottom());
+    };
+
+    for (int i = 0; i < historySize; ++i)
+    {
+        const auto& point = history[(size_t)((historyEnd + i) % historySize)];
+        const auto x = area.getX() + step * (float)i;
+
+        if (i == 0)
+        {
+            inputPath.startNewSubPath(x, toY(point.input));
+            outputPath.startNewSubPath(x, toY(point.output));
+        }
+        else
+        {
+            inputPath.lineTo(x, toY(point.input));
+            outputPath.lineTo(x, toY(point.output));
+        }
+    }
+}
+
+void SignalDisplay::rebuildCurvePaths()
+{
+    curvePath.clear();
+    dotPath.clear();
+
+    if (curveArea.isEmpty())
+        return;
+
+    if (hasCurve)
+    {
+        curvePath.startNewSubPath(toCurvePoint(curveInput[0], curveOutput[0]));
+
+        for (int i = 1; i < curveResolution; ++i)
+            curvePath.lineTo(toCurvePoint(curveInput[(size_t)i], curveOutput[(size_t)i]));
+    }
+
+    // the newest pairs show where the signal actually sits on the curve
+    for (int i = historySize - dotCount; i < historySize; ++i)
+    {
+        const auto& point = history[(size_t)((historyEnd + i) % historySize)];
+        dotPath.addRectangle(juce::Rectangle<float>(2.0f, 2.0f).withCentre(toCurvePoint(point.input, point.output)));
+    }
+}
+
+juce::Point<float> SignalDisplay::toCurvePoint(float input, float output) const noexcept
+{
+    const auto area = curveArea.toFloat().reduced(1.0f);
+    const auto clamp = [](float v) { return juce::jlimit(-displayRange, displayRange, v); };
+
+    return { juce::jmap(clamp(input), -displayRange, displayRange, area.getX(), area.getRight()),
+             juce::jmap(clamp(output), displayRange, -displayRange, area.getY(), area.getBottom()) };
+}
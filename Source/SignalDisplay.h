@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include "PluginProcessor.h"
+#include <JuceHeader.h>
+
+/*  Input/output scope and transfer curve, fed by the processor's ScopeFifo.
+
+    The grid and labels are drawn once into a cached image in resized().
+    A 30 Hz timer drains the FIFO, rebuilds the paths and repaints only the
+    panels whose contents changed; the static curve is recomputed only when
+    the mode or its parameters change.
+*/
+class SignalDisplay : public juce::Component, private juce::Timer
+{
+public:
+    explicit SignalDisplay(ZLDistortV2AudioProcessor&);
+    ~SignalDisplay() override;
+
+    void paint(juce::Graphics&) override;
+    void resized() override;
+
+private:
+    void timerCallback() override;
+
+    bool readScope();
+    bool updateTransferCurve();
+    void rebuildScopePaths();
+    void rebuildCurvePaths();
+
+    juce::Point<float> toCurvePoint(float input, float output) const noexcept;
+
+    ZLDistortV2AudioProcessor& processorRef;
+
+    static constexpr int historySize = 512;     // about a quarter second
+    static constexpr int dotCount = 128;        // live pairs on the curve
+    static constexpr int curveResolution = 256;
+
+    std::array<zl::ScopeFifo::Point, (size_t)historySize> history {};
+    std::array<zl::ScopeFifo::Point, (size_t)zl::ScopeFifo::capacity> incoming {};
+    int historyEnd = 0;
+
+    std::array<float, (size_t)curveResolution> curveInput {}, curveOutput {};
+    std::array<float, 6> curveKey {};   // mode, distortion, dry/wet, precision, scale, bands
+    bool curveIsValid = false, hasCurve = false;
+
+    juce::Rectangle<int> scopeArea, curveArea;
+    juce::Image background;
+    juce::Path inputPath, outputPath, curvePath, dotPath;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SignalDisplay)
+};
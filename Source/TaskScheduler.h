@@ -0,0 +1,191 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+
+// Set to 0 to keep offline (non-realtime) renders single-threaded.
+#ifndef ZLDISTORT_OFFLINE_MULTITHREADING
+ #define ZLDISTORT_OFFLINE_MULTITHREADING 1
+#endif
+
+namespace zl
+{
+    /*  Small work-stealing pool for offline rendering.
+
+        parallelFor() splits [0, numTasks) into one contiguous range per
+        thread, the caller included. Each thread first works through its own
+        range and then steals single tasks from the others' ranges, so an
+        uneven split still keeps every core busy. It returns once every task
+        has finished and every worker is idle again.
+
+        Tasks must write to disjoint outputs. Any reduction is done by the
+        caller afterwards in a fixed order, so results never depend on which
+        thread ran which task.
+
+        One pool serves the whole process (SharedResourcePointer), so a bounce
+        of many instances doesn't start a set of workers per instance: each
+        one calls addUser() / removeUser(), and the pool runs while any of
+        them renders offline. Only one parallelFor() uses the workers at a
+        time; a caller that finds them busy runs its tasks itself rather
+        than wait.
+    */
+    class TaskScheduler
+    {
+    public:
+        ~TaskScheduler() { stop(); }
+
+        void addUser(int numWorkers)
+        {
+            const juce::ScopedLock lock(userLock);
+
+            if (numUsers++ == 0)
+                start(numWorkers);
+        }
+
+        void removeUser()
+        {
+            const juce::ScopedLock lock(userLock);
+            jassert(numUsers > 0);
+
+            if (numUsers > 0 && --numUsers == 0)
+                stop();
+        }
+
+        void start(int numWorkers)
+        {
+            // waits for a running parallelFor()
+            const juce::ScopedLock lock(jobLock);
+            numWorkers = juce::jmax(0, numWorkers);
+
+            if (numWorkers == (int)workers.size())
+                return;
+
+            stop();
+            ranges = std::make_unique<Range[]>((size_t)numWorkers + 1);
+
+            for (int i = 0; i < numWorkers; ++i)
+            {
+                workers.push_back(std::make_unique<Worker>(*this, i + 1));
+                workers.back()->startThread();
+            }
+
+            runningWorkers.store(numWorkers, std::memory_order_release);
+        }
+
+        void stop()
+        {
+            const juce::ScopedLock lock(jobLock);
+            runningWorkers.store(0, std::memory_order_release);
+
+            for (auto& worker : workers)
+                worker->signalThreadShouldExit();
+
+            for (auto& worker : workers)
+            {
+                worker->wake.signal();
+                worker->stopThread(1000);
+            }
+
+            workers.clear();
+        }
+
+        // any thread
+        bool isRunning() const noexcept { return runningWorkers.load(std::memory_order_acquire) > 0; }
+        int getNumThreads() const noexcept { return (int)workers.size() + 1; }
+
+        template <typename Task>
+        void parallelFor(int numTasks, Task&& task)
+        {
+            const juce::ScopedTryLock lock(jobLock);
+
+            if (! lock.isLocked() || workers.empty() || numTasks <= 1)
+            {
+                for (int i = 0; i < numTasks; ++i)
+                    task(i);
+
+                return;
+            }
+
+            context = &task;
+            invoke = [](void* c, int index) { (*static_cast<std::remove_reference_t<Task>*>(c))(index); };
+
+            const auto numThreads = getNumThreads();
+
+            for (int t = 0; t < numThreads; ++t)
+            {
+                ranges[(size_t)t].next = numTasks * t / numThreads;
+                ranges[(size_t)t].end = numTasks * (t + 1) / numThreads;
+            }
+
+            busyWorkers = (int)workers.size();
+
+            for (auto& worker : workers)
+                worker->wake.signal();
+
+            runTasks(0);
+
+            // a worker still scanning the ranges must not see the next job's
+            while (busyWorkers.load(std::memory_order_acquire) > 0)
+                std::this_thread::yield();
+        }
+
+    private:
+        struct Range
+        {
+            std::atomic<int> next { 0 };
+            int end = 0;
+        };
+
+        struct Worker : public juce::Thread
+        {
+            Worker(TaskScheduler& s, int i) : juce::Thread("ZLDistort offline worker"), scheduler(s), index(i) {}
+
+            void run() override
+            {
+                while (! threadShouldExit())
+                {
+                    if (! wake.wait(100) || threadShouldExit())
+                        continue;
+
+                    scheduler.runTasks(index);
+                    scheduler.busyWorkers.fetch_sub(1, std::memory_order_release);
+                }
+            }
+
+            TaskScheduler& scheduler;
+            const int index;
+            juce::WaitableEvent wake;
+        };
+
+        bool claimAndRun(Range& range)
+        {
+            const auto task = range.next.fetch_add(1, std::memory_order_relaxed);
+
+            if (task >= range.end)
+                return false;
+
+            invoke(context, task);
+            return true;
+        }
+
+        void runTasks(int self)
+        {
+            const auto numThreads = getNumThreads();
+
+            while (claimAndRun(ranges[(size_t)self])) {}
+
+            for (int offset = 1; offset < numThreads; ++offset)
+                while (claimAndRun(ranges[(size_t)((self + offset) % numThreads)])) {}
+        }
+
+        juce::CriticalSection userLock, jobLock;
+        int numUsers = 0;
+        std::atomic<int> runningWorkers { 0 };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::unique_ptr<Range[]> ranges;
+        std::atomic<int> busyWorkers { 0 };
+
+        void* context = nullptr;
+        void (*invoke)(void*, int) = nullptr;
+    };
+}
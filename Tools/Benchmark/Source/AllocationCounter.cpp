@@ -0,0 +1,50 @@
+﻿#include "AllocationCounter.h"
+
+#if ZLDISTORT_INSTRUMENTATION_HOOKS
+ #error "Instrumentation.cpp would replace operator new a second time; leave ZLDISTORT_INSTRUMENTATION_HOOKS at 0 here"
+#endif
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // per thread: the plugin's background threads allocate by design while
+    // the benchmark times the audio thread
+    thread_local bool counting = false;
+    thread_local size_t numAllocations = 0;
+
+    void* allocate(std::size_t size)
+    {
+        if (counting)
+            ++numAllocations;
+
+        if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+}
+
+void zl::AllocationCounter::start() noexcept
+{
+    numAllocations = 0;
+    counting = true;
+}
+
+size_t zl::AllocationCounter::stop() noexcept
+{
+    counting = false;
+    return numAllocations;
+}
+
+// the aligned overloads are left alone: their default versions pair with each other
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { try { return allocate(size); } catch (...) { return nullptr; } }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
@@ -0,0 +1,19 @@
+﻿#pragma once
+
+#include <cstddef>
+
+namespace zl
+{
+    /*  Counts calls to the global operator new made by the calling thread
+        between start() and stop(); other threads are never counted. The
+        replacement operators are defined in AllocationCounter.cpp, so linking
+        that file into a target is enough to count every allocation it makes.
+    */
+    struct AllocationCounter
+    {
+        static void start() noexcept;
+
+        // stops counting and returns the number of allocations since start()
+        static size_t stop() noexcept;
+    };
+}
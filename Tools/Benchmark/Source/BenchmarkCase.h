@@ -0,0 +1,155 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../OfflineRender/Source/ParameterFile.h"
+#include "AllocationCounter.h"
+
+namespace zl
+{
+    struct BenchmarkCase
+    {
+        int mode = 0;
+        bool softClip = true;
+        int blockSize = 512;
+        double sampleRate = 48000.0;
+        int numChannels = 2;
+        int numBands = 10;
+        int harmonicEngine = ZLDistortV2AudioProcessor::FilterBankEngine;
+
+        // also the key in the baseline files, so keep it stable
+        juce::String getName(const juce::StringArray& modeNames) const
+        {
+            auto name = modeNames[mode].removeCharacters(" ")
+                      + " sc=" + (softClip ? "on" : "off")
+                      + " block=" + juce::String(blockSize)
+                      + " sr=" + juce::String((int)sampleRate)
+                      + " ch=" + juce::String(numChannels);
+
+            if (mode == ZLDistortV2AudioProcessor::Harmonic)
+            {
+                name << " bands=" << numBands;
+
+                // filter-bank names predate the engine choice
+                if (harmonicEngine == ZLDistortV2AudioProcessor::SpectralEngine)
+                    name << " engine=spectral";
+                else if (harmonicEngine == ZLDistortV2AudioProcessor::MultirateEngine)
+                    name << " engine=multirate";
+            }
+
+            return name;
+        }
+    };
+
+    struct BenchmarkResult
+    {
+        double nsPerSample = 0.0;       // per sample frame, all channels together
+        double realtimeFactor = 0.0;    // seconds of audio per second of processing
+        size_t allocations = 0;         // inside processBlock, over all timed blocks
+
+        juce::var toVar() const
+        {
+            auto* object = new juce::DynamicObject();
+            object->setProperty("nsPerSample", nsPerSample);
+            object->setProperty("realtimeFactor", realtimeFactor);
+            object->setProperty("allocations", (juce::int64)allocations);
+            return object;
+        }
+
+        static BenchmarkResult fromVar(const juce::var& value)
+        {
+            BenchmarkResult result;
+            result.nsPerSample = value["nsPerSample"];
+            result.realtimeFactor = value["realtimeFactor"];
+            result.allocations = (size_t)(juce::int64)value["allocations"];
+            return result;
+        }
+    };
+
+    inline void setPlainValue(juce::AudioProcessorValueTreeState& apvts, const juce::String& id, float value)
+    {
+        auto* parameter = apvts.getParameter(id);
+        jassert(parameter != nullptr);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    /*  Drives a fresh processor with noise for `seconds` of audio, `repeats`
+        times, and keeps the fastest pass. Only the processBlock calls are
+        timed; refilling the input buffer is not.
+    */
+    inline BenchmarkResult runBenchmarkCase(const BenchmarkCase& benchmarkCase, const ParameterFile& baseParameters,
+                                            double seconds, int repeats)
+    {
+        const auto numChannels = benchmarkCase.numChannels;
+        const auto blockSize = benchmarkCase.blockSize;
+        const auto sampleRate = benchmarkCase.sampleRate;
+
+        ZLDistortV2AudioProcessor processor;
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+        layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+        processor.setBusesLayout(layout);
+
+        baseParameters.applyTo(processor.parameters);
+        setPlainValue(processor.parameters, "DISTORTION_MODE", (float)benchmarkCase.mode);
+        setPlainValue(processor.parameters, "SOFT_CLIP", benchmarkCase.softClip ? 1.0f : 0.0f);
+        setPlainValue(processor.parameters, "NUM_BANDS", (float)benchmarkCase.numBands);
+        setPlainValue(processor.parameters, "HARMONIC_ENGINE", (float)benchmarkCase.harmonicEngine);
+
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        // what the first block with signal would ask the background thread for
+        processor.finishPreparation();
+
+        juce::AudioBuffer<float> source(numChannels, blockSize), buffer(numChannels, blockSize);
+        juce::Random random(1);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                source.setSample(ch, i, random.nextFloat() - 0.5f);
+
+        juce::MidiBuffer midi;
+        const auto numBlocks = juce::jmax(1, juce::roundToInt(seconds * sampleRate / blockSize));
+
+        // warm up caches, smoothers and filter state before timing
+        for (int block = 0; block < juce::jmin(numBlocks, 16); ++block)
+        {
+            buffer.makeCopyOf(source, true);
+            processor.processBlock(buffer, midi);
+        }
+
+        auto fastestTicks = std::numeric_limits<juce::int64>::max();
+        size_t allocations = 0;
+
+        for (int pass = 0; pass < juce::jmax(1, repeats); ++pass)
+        {
+            juce::int64 ticks = 0;
+
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                buffer.makeCopyOf(source, true);
+
+                AllocationCounter::start();
+                const auto start = juce::Time::getHighResolutionTicks();
+                processor.processBlock(buffer, midi);
+                ticks += juce::Time::getHighResolutionTicks() - start;
+                allocations += AllocationCounter::stop();
+            }
+
+            fastestTicks = juce::jmin(fastestTicks, ticks);
+        }
+
+        processor.releaseResources();
+
+        const auto processingSeconds = juce::Time::highResolutionTicksToSeconds(fastestTicks);
+        const auto numSamples = (double)numBlocks * blockSize;
+
+        BenchmarkResult result;
+        result.nsPerSample = processingSeconds * 1.0e9 / numSamples;
+        result.realtimeFactor = processingSeconds > 0.0 ? (numSamples / sampleRate) / processingSeconds : 0.0;
+        result.allocations = allocations;
+        return result;
+    }
+}
@@ -0,0 +1,374 @@
+﻿#include <JuceHeader.h>
+#include "BenchmarkCase.h"
+#include "NullTests.h"
+#include <iostream>
+
+/*  ZLDistortBenchmark: times processBlock over a grid of settings.
+
+    The default grid is every distortion mode, soft clip on and off, block
+    sizes 16 to 8192, sample rates 44.1k to 192k, mono and stereo, and 1 to
+    20 bands in Harmonic mode with every Harmonic engine. Any axis can be narrowed with a comma list,
+    e.g. --modes 5 --blocks 64,512 --rates 48000.
+
+    --memory <n> prepares n instances with the first rate, block size and
+    channel count instead, and reports their memory. --instantiate <n> creates
+    n instances the same way, as a session template would, and reports the
+    mean time of each step up to opening and closing the editor.
+
+    --save writes the results as a JSON baseline. --baseline compares
+    against one and exits with 1 when a case is slower than the baseline by
+    more than --threshold percent, or allocates more than it did. Both runs
+    must use the same --seconds and --repeats.
+
+    --null-tests runs the settings that must pass the dry signal through
+    bit-exact (see NullTests.h) instead, and exits with 1 if any doesn't.
+*/
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "usage: ZLDistortBenchmark [options]\n"
+                     "  --modes <list>      DistortionType indices (default: all)\n"
+                     "  --blocks <list>     block sizes (default: 16,32,...,8192)\n"
+                     "  --rates <list>      sample rates (default: 44100,48000,88200,96000,176400,192000)\n"
+                     "  --channels <list>   channel counts (default: 1,2)\n"
+                     "  --bands <list>      Harmonic band counts (default: 1..20)\n"
+                     "  --engines <list>    Harmonic engines, 0 = filter bank, 1 = spectral, 2 = multirate (default: 0,1,2)\n"
+                     "  --quick             blocks 64,512,4096, rate 48000, bands 1,10,20\n"
+                     "  --null-tests        check the bit-exact dry paths and exit\n"
+                     "  --seconds <s>       audio per timed pass (default: 0.5)\n"
+                     "  --repeats <n>       timed passes, the fastest is kept (default: 3)\n"
+                     "  --params <file>     base parameters, JSON or XML preset\n"
+                     "  --memory <n>        report the memory of n prepared instances and exit\n"
+                     "  --instantiate <n>   time creating, preparing and opening n instances and exit\n"
+                     "  --save <file>       write the results as a baseline\n"
+                     "  --baseline <file>   compare against a saved baseline\n"
+                     "  --threshold <pct>   allowed slowdown against the baseline (default: 10)\n";
+    }
+
+    template <typename ValueType>
+    juce::Array<ValueType> parseList(const juce::String& text)
+    {
+        juce::Array<ValueType> values;
+
+        for (const auto& token : juce::StringArray::fromTokens(text, ",", ""))
+            values.add((ValueType)token.trim().getDoubleValue());
+
+        return values;
+    }
+
+    template <typename ValueType>
+    juce::Array<ValueType> range(ValueType first, ValueType last)
+    {
+        juce::Array<ValueType> values;
+
+        for (auto value = first; value <= last; ++value)
+            values.add(value);
+
+        return values;
+    }
+
+    juce::File resolve(const juce::String& path)
+    {
+        return juce::File::getCurrentWorkingDirectory().getChildFile(path);
+    }
+
+    juce::String kilobytes(size_t bytes)
+    {
+        return juce::String((double)bytes / 1024.0, 1) + " KB";
+    }
+
+    // identical instances, as a session full of them would have
+    void reportMemory(int numInstances, double sampleRate, int blockSize, int numChannels,
+                      const zl::ParameterFile& baseParameters)
+    {
+        std::vector<std::unique_ptr<ZLDistortV2AudioProcessor>> processors;
+
+        for (int i = 0; i < numInstances; ++i)
+        {
+            auto processor = std::make_unique<ZLDistortV2AudioProcessor>();
+
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+            layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+            processor->setBusesLayout(layout);
+
+            baseParameters.applyTo(processor->parameters);
+            processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+            processor->prepareToPlay(sampleRate, blockSize);
+            processors.push_back(std::move(processor));
+        }
+
+        const auto report = processors.front()->getMemoryReport();
+        const auto instanceTotal = report.instanceBytes * (size_t)numInstances;
+
+        std::cout << numInstances << " instances at " << sampleRate << " Hz, " << blockSize << " samples, "
+                  << numChannels << " channels\n"
+                  << "  per instance  " << kilobytes(report.instanceBytes) << "\n"
+                  << "  shared        " << kilobytes(report.sharedBytes) << " in " << report.numSharedTables << " tables\n"
+                  << "  total         " << kilobytes(instanceTotal + report.sharedBytes)
+                  << " (" << kilobytes(instanceTotal + report.unsharedBytes) << " with a table copy per instance)\n";
+    }
+
+    // every instance is kept alive, so later ones find the shared tables built
+    void reportInstantiation(int numInstances, double sampleRate, int blockSize, int numChannels,
+                             const zl::ParameterFile& baseParameters)
+    {
+        std::vector<std::unique_ptr<ZLDistortV2AudioProcessor>> processors;
+        double layoutMs = 0.0, constructorMs = 0.0, prepareMs = 0.0, finishMs = 0.0, editorMs = 0.0;
+
+        const auto timed = [](double& total, auto&& step)
+        {
+            const auto start = juce::Time::getMillisecondCounterHiRes();
+            step();
+            total += juce::Time::getMillisecondCounterHiRes() - start;
+        };
+
+        for (int i = 0; i < numInstances; ++i)
+        {
+            timed(layoutMs, [] { juce::ignoreUnused(ZLDistortV2AudioProcessor::createParameterLayout()); });
+
+            std::unique_ptr<ZLDistortV2AudioProcessor> processor;
+            timed(constructorMs, [&] { processor = std::make_unique<ZLDistortV2AudioProcessor>(); });
+
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+            layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+            processor->setBusesLayout(layout);
+
+            baseParameters.applyTo(processor->parameters);
+            processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+            timed(prepareMs, [&] { processor->prepareToPlay(sampleRate, blockSize); });
+            timed(finishMs, [&] { processor->finishPreparation(); });
+
+            timed(editorMs, [&] { std::unique_ptr<juce::AudioProcessorEditor> editor(processor->createEditor()); });
+
+            processors.push_back(std::move(processor));
+        }
+
+        const auto mean = [numInstances](double total) { return juce::String(total / numInstances, 3) + " ms"; };
+
+        std::cout << numInstances << " instances at " << sampleRate << " Hz, " << blockSize << " samples, "
+                  << numChannels << " channels, mean per instance\n"
+                  << "  parameter layout  " << mean(layoutMs) << "\n"
+                  << "  constructor       " << mean(constructorMs) << " (includes the layout)\n"
+                  << "  prepareToPlay     " << mean(prepareMs) << "\n"
+                  << "  first signal      " << mean(finishMs) << " (background thread, not in the total)\n"
+                  << "  editor open/close " << mean(editorMs) << "\n"
+                  << "  total             " << mean(constructorMs + prepareMs + editorMs) << "\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    auto modes = range(0, (int)ZLDistortV2AudioProcessor::Chebyshev);
+    juce::Array<int> blockSizes { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+    juce::Array<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+    juce::Array<int> channelCounts { 1, 2 };
+    auto bandCounts = range(1, 20);
+    juce::Array<int> harmonicEngines { ZLDistortV2AudioProcessor::FilterBankEngine, ZLDistortV2AudioProcessor::SpectralEngine,
+                                       ZLDistortV2AudioProcessor::MultirateEngine };
+
+    double seconds = 0.5, threshold = 10.0;
+    int repeats = 3, memoryInstances = 0, instantiateCount = 0;
+    bool nullTests = false;
+    zl::ParameterFile baseParameters;
+    juce::File saveFile, baselineFile;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(argv[i]);
+
+        if (arg == "--help" || arg == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+
+        if (arg == "--quick")
+        {
+            blockSizes = { 64, 512, 4096 };
+            sampleRates = { 48000.0 };
+            bandCounts = { 1, 10, 20 };
+            continue;
+        }
+
+        if (arg == "--null-tests")
+        {
+            nullTests = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "missing value for " << arg << "\n";
+            return 1;
+        }
+
+        const juce::String value(argv[++i]);
+
+        if      (arg == "--modes")      modes = parseList<int>(value);
+        else if (arg == "--blocks")     blockSizes = parseList<int>(value);
+        else if (arg == "--rates")      sampleRates = parseList<double>(value);
+        else if (arg == "--channels")   channelCounts = parseList<int>(value);
+        else if (arg == "--bands")      bandCounts = parseList<int>(value);
+        else if (arg == "--engines")    harmonicEngines = parseList<int>(value);
+        else if (arg == "--seconds")    seconds = juce::jmax(0.01, value.getDoubleValue());
+        else if (arg == "--repeats")    repeats = juce::jmax(1, value.getIntValue());
+        else if (arg == "--threshold")  threshold = juce::jmax(0.0, value.getDoubleValue());
+        else if (arg == "--memory")     memoryInstances = juce::jmax(1, value.getIntValue());
+        else if (arg == "--instantiate") instantiateCount = juce::jmax(1, value.getIntValue());
+        else if (arg == "--save")       saveFile = resolve(value);
+        else if (arg == "--baseline")   baselineFile = resolve(value);
+        else if (arg == "--params")
+        {
+            const auto result = baseParameters.load(resolve(value));
+
+            if (result.failed())
+            {
+                std::cerr << result.getErrorMessage() << "\n";
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (nullTests)
+    {
+        int numFailures = 0;
+
+        for (const auto& test : zl::getNullTests())
+        {
+            const auto failure = zl::runNullTest(test);
+            std::cout << test.name.paddedRight(' ', 40) << (failure.isEmpty() ? "ok" : "FAILED: " + failure) << std::endl;
+
+            if (failure.isNotEmpty())
+                ++numFailures;
+        }
+
+        return numFailures > 0 ? 1 : 0;
+    }
+
+    if (memoryInstances > 0)
+    {
+        reportMemory(memoryInstances, sampleRates.getFirst(), blockSizes.getFirst(), channelCounts.getFirst(), baseParameters);
+        return 0;
+    }
+
+    if (instantiateCount > 0)
+    {
+        reportInstantiation(instantiateCount, sampleRates.getFirst(), blockSizes.getFirst(), channelCounts.getFirst(), baseParameters);
+        return 0;
+    }
+
+    juce::var baseline;
+
+    if (baselineFile != juce::File())
+    {
+        baseline = juce::JSON::parse(baselineFile);
+
+        if (! baseline.isObject())
+        {
+            std::cerr << "cannot read baseline " << baselineFile.getFullPathName() << "\n";
+            return 1;
+        }
+
+        if (baseline["cpu"].toString() != juce::SystemStats::getCpuModel())
+            std::cerr << "warning: baseline was recorded on " << baseline["cpu"].toString() << "\n";
+
+        // allocation counts are totals over every timed pass
+        if (std::abs((double)baseline["seconds"] - seconds) > 1.0e-9 || (int)baseline["repeats"] != repeats)
+        {
+            std::cerr << "baseline was recorded with --seconds " << baseline["seconds"].toString()
+                      << " --repeats " << baseline["repeats"].toString() << ", run with the same\n";
+            return 1;
+        }
+    }
+
+    const auto modeNames = ZLDistortV2AudioProcessor().parameters.getParameter("DISTORTION_MODE")->getAllValueStrings();
+
+    juce::Array<zl::BenchmarkCase> cases;
+
+    for (auto mode : modes)
+        for (auto softClip : { true, false })
+            for (auto blockSize : blockSizes)
+                for (auto sampleRate : sampleRates)
+                    for (auto numChannels : channelCounts)
+                    {
+                        // band count and engine only matter in Harmonic mode
+                        const auto isHarmonic = mode == ZLDistortV2AudioProcessor::Harmonic;
+                        const auto bands = isHarmonic ? bandCounts : juce::Array<int> { 10 };
+                        const auto engines = isHarmonic ? harmonicEngines
+                                                        : juce::Array<int> { ZLDistortV2AudioProcessor::FilterBankEngine };
+
+                        for (auto numBands : bands)
+                            for (auto engine : engines)
+                                cases.add({ mode, softClip, blockSize, sampleRate, numChannels, numBands, engine });
+                    }
+
+    auto* results = new juce::DynamicObject();
+    juce::var resultsVar(results);
+    int numRegressions = 0;
+
+    for (const auto& benchmarkCase : cases)
+    {
+        const auto name = benchmarkCase.getName(modeNames);
+        const auto result = zl::runBenchmarkCase(benchmarkCase, baseParameters, seconds, repeats);
+        results->setProperty(name, result.toVar());
+
+        auto line = name.paddedRight(' ', 56)
+                  + juce::String(result.nsPerSample, 2).paddedLeft(' ', 10) + " ns/sample"
+                  + juce::String(result.realtimeFactor, 1).paddedLeft(' ', 10) + "x realtime"
+                  + juce::String((juce::int64)result.allocations).paddedLeft(' ', 6) + " allocs";
+
+        const auto reference = baseline["cases"][juce::Identifier(name)];
+
+        if (reference.isObject())
+        {
+            const auto expected = zl::BenchmarkResult::fromVar(reference);
+            const auto change = expected.nsPerSample > 0.0 ? (result.nsPerSample / expected.nsPerSample - 1.0) * 100.0 : 0.0;
+            line << (change >= 0.0 ? "  +" : "  ") << juce::String(change, 1) << "%";
+
+            if (change > threshold || result.allocations > expected.allocations)
+            {
+                line << "  REGRESSION";
+                ++numRegressions;
+            }
+        }
+
+        std::cout << line << std::endl;
+    }
+
+    if (saveFile != juce::File())
+    {
+        auto* root = new juce::DynamicObject();
+        juce::var rootVar(root);
+        root->setProperty("cpu", juce::SystemStats::getCpuModel());
+        root->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+        root->setProperty("seconds", seconds);
+        root->setProperty("repeats", repeats);
+        root->setProperty("cases", resultsVar);
+
+        if (! saveFile.replaceWithText(juce::JSON::toString(rootVar)))
+        {
+            std::cerr << "cannot write " << saveFile.getFullPathName() << "\n";
+            return 1;
+        }
+    }
+
+    if (numRegressions > 0)
+    {
+        std::cerr << numRegressions << " of " << cases.size() << " cases regressed by more than "
+                  << threshold << "% or allocate more than the baseline\n";
+        return 1;
+    }
+
+    return 0;
+}
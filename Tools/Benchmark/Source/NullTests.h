@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "BenchmarkCase.h"
+
+namespace zl
+{
+    /*  Settings under which the output must be the input, delayed by the
+        latency the processor reports, down to the last bit. Each case runs
+        a fresh 64-bit processor on noise that isn't representable in float,
+        so any stage that rounds the dry path through float shows up.
+    */
+    struct NullTest
+    {
+        juce::String name;
+        std::vector<std::pair<juce::String, float>> values;   // plain parameter values
+    };
+
+    inline std::vector<NullTest> getNullTests()
+    {
+        return {
+            { "spectral engine, dry only",
+              { { "DISTORTION_MODE", (float)ZLDistortV2AudioProcessor::Harmonic },
+                { "HARMONIC_ENGINE", (float)ZLDistortV2AudioProcessor::SpectralEngine },
+                { "DRYWET", 0.0f }, { "SOFT_CLIP", 0.0f } } },
+            { "Chebyshev, dry only",
+              { { "DISTORTION_MODE", (float)ZLDistortV2AudioProcessor::Chebyshev },
+                { "DRYWET", 0.0f }, { "SOFT_CLIP", 0.0f } } },
+            { "second-order ADAA at 1x, dry only",
+              { { "DISTORTION_MODE", (float)ZLDistortV2AudioProcessor::HardClip },
+                { "ANTIALIASING", 2.0f }, { "OVERSAMPLING", 0.0f },
+                { "DRYWET", 0.0f }, { "SOFT_CLIP", 0.0f } } }
+        };
+    }
+
+    // an empty string when the output matches
+    inline juce::String runNullTest(const NullTest& test, double sampleRate = 48000.0, int blockSize = 512,
+                                    int numChannels = 2, double seconds = 1.0)
+    {
+        ZLDistortV2AudioProcessor processor;
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+        layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+        processor.setBusesLayout(layout);
+
+        for (const auto& [id, value] : test.values)
+            setPlainValue(processor.parameters, id, value);
+
+        processor.setProcessingPrecision(juce::AudioProcessor::doublePrecision);
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+        processor.finishPreparation();
+
+        const auto numBlocks = juce::jmax(1, juce::roundToInt(seconds * sampleRate / blockSize));
+        const auto length = numBlocks * blockSize;
+
+        juce::AudioBuffer<double> input(numChannels, length), output(numChannels, length);
+        juce::Random random(1);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < length; ++i)
+                input.setSample(ch, i, random.nextDouble() - 0.5);
+
+        output.makeCopyOf(input, true);
+        juce::MidiBuffer midi;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            juce::AudioBuffer<double> view(output.getArrayOfWritePointers(), numChannels, block * blockSize, blockSize);
+            processor.processBlock(view, midi);
+        }
+
+        // reported by the first block, once the engine is switched in
+        const auto latency = processor.getLatencySamples();
+        processor.releaseResources();
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            for (int i = 0; i < length; ++i)
+            {
+                const auto expected = i >= latency ? input.getSample(ch, i - latency) : 0.0;
+
+                if (output.getSample(ch, i) != expected)
+                    return "channel " + juce::String(ch) + ", sample " + juce::String(i) + ": "
+                         + juce::String(output.getSample(ch, i), 17) + " instead of " + juce::String(expected, 17)
+                         + " (latency " + juce::String(latency) + ")";
+            }
+        }
+
+        return {};
+    }
+}
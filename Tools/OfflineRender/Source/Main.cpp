@@ -0,0 +1,140 @@
+﻿#include <JuceHeader.h>
+#include "ParameterFile.h"
+#include "RenderJob.h"
+#include <iostream>
+
+/*  ZLDistortOfflineRender: headless batch rendering through ZLDistortV2.
+
+        ZLDistortOfflineRender [options] <file or folder>...
+
+    Folders are searched recursively for .wav, .aif and .aiff files. Every
+    file is rendered on a worker pool, with one processor instance per file.
+*/
+
+namespace
+{
+    void printUsage()
+    {
+        std::cout << "usage: ZLDistortOfflineRender [options] <file or folder>...\n"
+                     "  --params <file>   JSON parameter object or XML preset\n"
+                     "  --out <folder>    output folder (default: next to each input)\n"
+                     "  --suffix <text>   appended to output file names (default: _zld)\n"
+                     "  --threads <n>     worker threads (default: number of cores)\n"
+                     "  --block <n>       processing block size (default: 1024)\n";
+    }
+
+    juce::File resolve(const juce::String& path)
+    {
+        return juce::File::getCurrentWorkingDirectory().getChildFile(path);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // the processor's parameter tree expects a message manager to exist
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    zl::ParameterFile parameterFile;
+    zl::RenderSettings settings;
+    auto numThreads = juce::SystemStats::getNumCpus();
+    juce::Array<juce::File> inputs;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(argv[i]);
+        const auto hasValue = i + 1 < argc;
+
+        if (arg == "--help" || arg == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+
+        if (arg.startsWith("--") && ! hasValue)
+        {
+            std::cerr << "missing value for " << arg << "\n";
+            return 1;
+        }
+
+        if (arg == "--params")
+        {
+            const auto result = parameterFile.load(resolve(argv[++i]));
+
+            if (result.failed())
+            {
+                std::cerr << result.getErrorMessage() << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--out")        settings.outputDirectory = resolve(argv[++i]);
+        else if (arg == "--suffix")     settings.suffix = argv[++i];
+        else if (arg == "--threads")    numThreads = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+        else if (arg == "--block")      settings.blockSize = juce::jlimit(32, 65536, juce::String(argv[++i]).getIntValue());
+        else if (arg.startsWith("--"))
+        {
+            std::cerr << "unknown option " << arg << "\n";
+            return 1;
+        }
+        else
+        {
+            const auto file = resolve(arg);
+
+            if (file.isDirectory())
+                inputs.addArray(file.findChildFiles(juce::File::findFiles, true, "*.wav;*.aif;*.aiff"));
+            else
+                inputs.add(file);
+        }
+    }
+
+    if (inputs.isEmpty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (settings.outputDirectory != juce::File() && ! settings.outputDirectory.createDirectory())
+    {
+        std::cerr << "cannot create " << settings.outputDirectory.getFullPathName() << "\n";
+        return 1;
+    }
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    juce::ThreadPool pool(numThreads);
+    juce::CriticalSection consoleLock;
+    std::atomic<int> numFailed { 0 };
+
+    for (const auto& input : inputs)
+    {
+        pool.addJob([&, input]
+        {
+            const auto output = settings.getOutputFile(input);
+            const auto start = juce::Time::getMillisecondCounterHiRes();
+
+            const auto result = output == input
+                ? juce::Result::fail("output would overwrite the input, set --out or --suffix")
+                : zl::renderFile(formats, parameterFile, settings, input, output);
+
+            const auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+            const juce::ScopedLock sl(consoleLock);
+
+            if (result.wasOk())
+            {
+                std::cout << input.getFileName() << " -> " << output.getFullPathName()
+                          << " (" << juce::String(seconds, 2) << " s)\n";
+            }
+            else
+            {
+                ++numFailed;
+                std::cerr << input.getFileName() << ": " << result.getErrorMessage() << "\n";
+            }
+        });
+    }
+
+    while (pool.getNumJobs() > 0)
+        juce::Thread::sleep(50);
+
+    std::cout << inputs.size() - numFailed.load() << " of " << inputs.size() << " files rendered\n";
+    return numFailed.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+
+namespace zl
+{
+    /*  Parameter values for headless rendering, loaded once and applied to
+        every processor instance. Two formats are accepted:
+
+            .json   an object of parameter IDs, e.g.
+                    { "DISTORTION": 6.5, "DISTORTION_MODE": "Foldback", "OVERSAMPLING": "4x" }
+                    numbers are plain (denormalised) values, strings are choice names
+            other   an XML preset holding the processor's APVTS state
+    */
+    class ParameterFile
+    {
+    public:
+        juce::Result load(const juce::File& file)
+        {
+            if (! file.existsAsFile())
+                return juce::Result::fail("parameter file not found: " + file.getFullPathName());
+
+            if (file.hasFileExtension("json"))
+            {
+                const auto result = juce::JSON::parse(file.loadFileAsString(), values);
+
+                if (result.failed())
+                    return juce::Result::fail(file.getFileName() + ": " + result.getErrorMessage());
+
+                if (values.getDynamicObject() == nullptr)
+                    return juce::Result::fail(file.getFileName() + ": expected a JSON object");
+
+                return juce::Result::ok();
+            }
+
+            if (auto xml = juce::parseXML(file))
+                state = juce::ValueTree::fromXml(*xml);
+
+            if (! state.isValid())
+                return juce::Result::fail(file.getFileName() + ": not a JSON or XML preset");
+
+            return juce::Result::ok();
+        }
+
+        juce::Result applyTo(juce::AudioProcessorValueTreeState& apvts) const
+        {
+            if (state.isValid())
+            {
+                if (! state.hasType(apvts.state.getType()))
+                    return juce::Result::fail("preset was not saved by ZLDistortV2");
+
+                apvts.replaceState(state.createCopy());
+                return juce::Result::ok();
+            }
+
+            if (auto* object = values.getDynamicObject())
+            {
+                for (const auto& property : object->getProperties())
+                {
+                    const auto id = property.name.toString();
+                    auto* parameter = apvts.getParameter(id);
+
+                    if (parameter == nullptr)
+                        return juce::Result::fail("unknown parameter " + id);
+
+                    const auto& value = property.value;
+                    float normalised = 0.0f;
+
+                    if (value.isString())
+                    {
+                        auto* choice = dynamic_cast<juce::AudioParameterChoice*>(parameter);
+
+                        if (choice == nullptr || ! choice->choices.contains(value.toString()))
+                            return juce::Result::fail("invalid value \"" + value.toString() + "\" for " + id);
+
+                        normalised = parameter->getValueForText(value.toString());
+                    }
+                    else
+                    {
+                        normalised = parameter->convertTo0to1((float)value);
+                    }
+
+                    parameter->setValueNotifyingHost(normalised);
+                }
+            }
+
+            return juce::Result::ok();
+        }
+
+    private:
+        juce::var values;
+        juce::ValueTree state;
+    };
+}
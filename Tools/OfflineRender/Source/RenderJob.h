@@ -0,0 +1,128 @@
+﻿#pragma once
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "ParameterFile.h"
+
+namespace zl
+{
+    struct RenderSettings
+    {
+        int blockSize = 1024;
+        juce::File outputDirectory;     // empty: next to each input file
+        juce::String suffix = "_zld";
+
+        juce::File getOutputFile(const juce::File& input) const
+        {
+            const auto directory = outputDirectory == juce::File() ? input.getParentDirectory() : outputDirectory;
+            return directory.getChildFile(input.getFileNameWithoutExtension() + suffix + input.getFileExtension());
+        }
+    };
+
+    // WAV and AIFF are memory-mapped so the OS pages the file in as it is
+    // read; other formats fall back to a normal streaming reader
+    inline std::unique_ptr<juce::AudioFormatReader> createStreamingReader(juce::AudioFormatManager& formats,
+                                                                          const juce::File& file)
+    {
+        if (auto* format = formats.findFormatForFileExtension(file.getFileExtension()))
+        {
+            std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(format->createMemoryMappedReader(file));
+
+            if (mapped != nullptr && mapped->mapEntireFile())
+                return mapped;
+        }
+
+        return std::unique_ptr<juce::AudioFormatReader>(formats.createReaderFor(file));
+    }
+
+    /*  Renders one file through its own processor instance, one block at a
+        time: a block is read, processed and written before the next one is
+        read, so memory use does not depend on the file length.
+
+        The oversampling latency is removed, so the output lines up with the
+        input and has the same length. Safe to call from several threads at
+        once as long as each call renders a different file.
+    */
+    inline juce::Result renderFile(juce::AudioFormatManager& formats,
+                                   const ParameterFile& parameters,
+                                   const RenderSettings& settings,
+                                   const juce::File& input,
+                                   const juce::File& output)
+    {
+        auto reader = createStreamingReader(formats, input);
+
+        if (reader == nullptr)
+            return juce::Result::fail("cannot read " + input.getFullPathName());
+
+        auto* outputFormat = formats.findFormatForFileExtension(output.getFileExtension());
+
+        if (outputFormat == nullptr)
+            return juce::Result::fail("no writer for " + output.getFileExtension());
+
+        const auto numChannels = (int)reader->numChannels;
+        const auto sampleRate = reader->sampleRate;
+
+        ZLDistortV2AudioProcessor processor;
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+        layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+
+        if (! processor.setBusesLayout(layout))
+            return juce::Result::fail(juce::String(numChannels) + " channels are not supported");
+
+        const auto applied = parameters.applyTo(processor.parameters);
+
+        if (applied.failed())
+            return applied;
+
+        // parameters are set before prepareToPlay so the smoothers start at them
+        processor.setNonRealtime(true);
+        processor.setRateAndBufferSizeDetails(sampleRate, settings.blockSize);
+        processor.prepareToPlay(sampleRate, settings.blockSize);
+
+        output.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream>(output);
+
+        if (stream->failedToOpen())
+            return juce::Result::fail("cannot write " + output.getFullPathName());
+
+        const auto bitDepths = outputFormat->getPossibleBitDepths();
+        const auto bitDepth = bitDepths.contains((int)reader->bitsPerSample) ? (int)reader->bitsPerSample : 24;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(outputFormat->createWriterFor(stream.get(), sampleRate,
+            (unsigned int)numChannels, bitDepth, reader->metadataValues, 0));
+
+        if (writer == nullptr)
+            return juce::Result::fail("cannot create a writer for " + output.getFullPathName());
+
+        stream.release(); // owned by the writer now
+
+        juce::AudioBuffer<float> buffer(numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+
+        // run `latency` extra samples of silence through to flush the filters
+        const auto latency = (juce::int64)processor.getLatencySamples();
+        const auto length = reader->lengthInSamples;
+
+        for (juce::int64 position = 0; position < length + latency; position += settings.blockSize)
+        {
+            const auto numSamples = (int)juce::jmin((juce::int64)settings.blockSize, length + latency - position);
+            buffer.setSize(numChannels, numSamples, false, false, true);
+
+            // reads past the end of the file come back as silence
+            if (! reader->read(&buffer, 0, numSamples, position, true, true))
+                return juce::Result::fail("read error in " + input.getFullPathName());
+
+            processor.processBlock(buffer, midi);
+
+            const auto skip = (int)juce::jlimit((juce::int64)0, (juce::int64)numSamples, latency - position);
+
+            if (! writer->writeFromAudioSampleBuffer(buffer, skip, numSamples - skip))
+                return juce::Result::fail("write error in " + output.getFullPathName());
+        }
+
+        processor.releaseResources();
+        return juce::Result::ok();
+    }
+}